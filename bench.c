@@ -0,0 +1,143 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  bench.c
+ *
+ *    Description:  Microbenchmark for the kernels of the lz floating point compression library
+ *
+ *        Version:  1.0
+ *        Created:  10/18/2026 09:00:00 AM CDT
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Leonardo A. Bautista Gomez (leobago@anl.gov),
+ *        Company:  Argonne National Laboratory
+ *
+ * =====================================================================================
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "lz.h"
+
+#define REPEAT              5
+
+static const char *isaName[] = {"scalar", "sse2", "avx2"};
+
+
+double getTime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec+(t.tv_usec/1000000.0);
+}
+
+
+int fillArray(uchar *buf, ulong nbEle, int prec)
+{
+    ulong i;
+    double point = 300.0;
+    srand(time(NULL));
+    for (i = 0; i < nbEle; i++)
+    {
+        point = point+(((rand()%1000)/1000.0)*((rand()%3)-1));
+        if (prec == 4)
+        {
+            float fpoint = (float) point;
+            memcpy(buf+(i*prec), &fpoint, prec);
+        } else {
+            memcpy(buf+(i*prec), &point, prec);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int benchKernels(uchar *srcBuf, ulong nbEle, int prec, int isa)
+{
+    int i, r;
+    double t, tSplit = 1e30, tGather = 1e30, tTrip = 1e30, gb = (nbEle*prec)/(1024.0*1024.0*1024.0);
+    uchar *planes[8], *refPlanes[8], *dstBuf = malloc(nbEle*prec);
+
+    for (i = 0; i < prec; i++)
+    {
+        planes[i] = malloc(nbEle);
+        refPlanes[i] = malloc(nbEle);
+    }
+    lzSplitScalar(refPlanes, srcBuf, nbEle, prec);
+    if (lzSelectIsa(isa) != isa) return EXIT_FAILURE;
+    for (r = 0; r < REPEAT; r++)
+    {
+        t = getTime();
+        lzSplitPlanes(planes, srcBuf, nbEle, prec);
+        t = getTime()-t;
+        if (t < tSplit) tSplit = t;
+        t = getTime();
+        lzGatherPlanes(dstBuf, planes, nbEle, prec);
+        t = getTime()-t;
+        if (t < tGather) tGather = t;
+        t = getTime();
+        lzSplitPlanes(planes, srcBuf, nbEle, prec);
+        lzGatherPlanes(dstBuf, planes, nbEle, prec);
+        t = getTime()-t;
+        if (t < tTrip) tTrip = t;
+    }
+    for (i = 0; i < prec; i++)
+    {
+        if (memcmp(planes[i], refPlanes[i], nbEle) != 0)
+        {
+            printf("Plane %d differs from the scalar split!\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    if (memcmp(dstBuf, srcBuf, nbEle*prec) != 0)
+    {
+        printf("The gathered array differs from the original!\n");
+        return EXIT_FAILURE;
+    }
+    printf("| split  |  %d  | %6s | %08.3f | %07.2f |\n", prec*8, isaName[isa], tSplit, gb/tSplit);
+    printf("| gather |  %d  | %6s | %08.3f | %07.2f |\n", prec*8, isaName[isa], tGather, gb/tGather);
+    printf("| trip   |  %d  | %6s | %08.3f | %07.2f |\n", prec*8, isaName[isa], tTrip, gb/tTrip);
+    for (i = 0; i < prec; i++)
+    {
+        free(planes[i]);
+        free(refPlanes[i]);
+    }
+    free(dstBuf);
+    return EXIT_SUCCESS;
+}
+
+
+int main(int argc, char *argv[])
+{
+    int isa, prec, size = 256;
+    ulong nbEle;
+    uchar *srcBuf;
+
+    if (argc == 2) size = atoi(argv[1]);
+    if (size <= 0)
+    {
+        printf("Usage: \n");
+        printf("   ./bench [size in MB]\n");
+        return EXIT_FAILURE;
+    }
+    srcBuf = malloc(size*1024UL*1024UL);
+    printf("==================================================\n");
+    printf("| Kernel | Bits |  ISA   | Time (s) |  GB/s   |\n");
+    printf("==================================================\n");
+    for (prec = 4; prec <= 8; prec = prec+4)
+    {
+        nbEle = (size*1024UL*1024UL)/prec;
+        fillArray(srcBuf, nbEle, prec);
+        for (isa = LZ_ISA_SCALAR; isa <= lzSupportedIsa(); isa++)
+        {
+            if (benchKernels(srcBuf, nbEle, prec, isa) == EXIT_FAILURE) return EXIT_FAILURE;
+        }
+    }
+    free(srcBuf);
+    return EXIT_SUCCESS;
+}
@@ -37,7 +37,7 @@ float reverseFloat( const float inFloat )
     return retVal;
 }
 
-double reverseDouble( const float inDouble )
+double reverseDouble( const double inDouble )
 {
     double retVal;
     char *doubleToConvert = ( char* ) & inDouble;
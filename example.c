@@ -155,8 +155,9 @@ float compressFile(char *pSrcFn, char *pDstFn, int level)
     inSize = ftell(pFile);
     fclose(pFile);
 
+    outSize = lzCompressBound(inSize);
     uchar *srcBuf = malloc(inSize);
-    uchar *dstBuf = malloc(inSize);
+    uchar *dstBuf = malloc(outSize);
     pFile = fopen(pSrcFn, "rb");
     if (pFile == NULL)
     {
@@ -230,10 +231,11 @@ float uncompressFile(char *pDstFn, char *pUcmFn)
 }
 
 
-float lzCompressFile(char *pSrcFn, char *pDstFn, int prec, short level, short protect)
+float lzCompressFile(char *pSrcFn, char *pDstFn, int prec, short level, double bound, short *protect)
 {
     struct timeval start, end;
     ulong outSize, inSize, nbEle;
+    lzInfo info;
 
     if ((prec != 4) && (prec != 8)) return EXIT_FAILURE;
     FILE *pFile = fopen(pSrcFn, "rb");
@@ -247,7 +249,9 @@ float lzCompressFile(char *pSrcFn, char *pDstFn, int prec, short level, short pr
     nbEle = inSize/prec;
     fclose(pFile);
 
-    uchar *dstBuf = malloc(inSize+88);
+    if (prec == 4) outSize = lzCompressFloatBound(nbEle, prec*8);
+    else outSize = lzCompressDoubleBound(nbEle, prec*8);
+    uchar *dstBuf = malloc(outSize);
     pFile = fopen(pSrcFn, "rb");
     if (pFile == NULL)
     {
@@ -259,14 +263,14 @@ float lzCompressFile(char *pSrcFn, char *pDstFn, int prec, short level, short pr
         float *daBuf = malloc(inSize);
         fread(daBuf, prec, nbEle, pFile);
         gettimeofday(&start, NULL);
-        lzCompressFloat(dstBuf, &outSize, daBuf, nbEle, level, protect);
+        lzCompressFloatErrorBound(dstBuf, &outSize, daBuf, nbEle, level, bound);
         gettimeofday(&end, NULL);
         free(daBuf);
     } else {
         double *daBuf = malloc(inSize);
         fread(daBuf, prec, nbEle, pFile);
         gettimeofday(&start, NULL);
-        lzCompressDouble(dstBuf, &outSize, daBuf, nbEle, level, protect);
+        lzCompressDoubleErrorBound(dstBuf, &outSize, daBuf, nbEle, level, bound);
         gettimeofday(&end, NULL);
         free(daBuf);
     }
@@ -279,6 +283,7 @@ float lzCompressFile(char *pSrcFn, char *pDstFn, int prec, short level, short pr
     }
     fwrite(dstBuf, 1, outSize, pFile);
     fclose(pFile);
+    if (lzGetInfo(&info, dstBuf, outSize) == EXIT_SUCCESS) *protect = (prec*8)-info.lossy;
     float tt = end.tv_sec-start.tv_sec+((end.tv_usec-start.tv_usec)/1000000.0);
     free(dstBuf);
     return tt;
@@ -289,6 +294,7 @@ float lzUncompressFile(char *pDstFn, char *pUcmFn, int prec)
 {
     struct timeval start, end;
     ulong outSize, inSize, darSize;
+    lzInfo info;
 
     if ((prec != 4) && (prec != 8)) return EXIT_FAILURE;
     FILE *pFile = fopen(pDstFn, "rb");
@@ -297,7 +303,6 @@ float lzUncompressFile(char *pDstFn, char *pUcmFn, int prec)
         printf("Failed to open input file.");
         return EXIT_FAILURE;
     }
-    fread(&outSize, 1, sizeof(ulong), pFile);
     fseek(pFile, 0, SEEK_END);
     inSize = ftell(pFile);
     fclose(pFile);
@@ -311,6 +316,13 @@ float lzUncompressFile(char *pDstFn, char *pUcmFn, int prec)
     }
     fread(srcBuf, 1, inSize, pFile);
     fclose(pFile);
+    if (lzGetInfo(&info, srcBuf, inSize) != EXIT_SUCCESS)
+    {
+        printf("Corrupted compressed file.");
+        return EXIT_FAILURE;
+    }
+    outSize = info.nbBytes;
+    if (info.prec != 0) prec = info.prec; // Only legacy files need to be told the precision
     if (prec == 4)
     {
         float *daBuf = malloc(outSize);
@@ -351,7 +363,8 @@ float lzUncompressFile(char *pDstFn, char *pUcmFn, int prec)
 
 int main(int argc, char *argv[])
 {
-    int i, res, level = 9, size = 1024, prec = sizeof(double);
+    int res, level = 9, size = 1024, prec = sizeof(double);
+    short protect = 0;
     char pSrcFn[64], pCmzFn[64], pUmzFn[64], pClzFn[64], pUlzFn[64];
     float cmpTime, dcpTime;
     double error;
@@ -399,26 +412,15 @@ int main(int argc, char *argv[])
     printf("| Bits | In (MB) | Out (MB) | CR (%%) | (X:1)  | Compress | Decomp | Error Bound | File \n");
     printf("========================================================================================\n");
    
-    for(i = 1; i <= (prec*8); i++)
-    {
-        sprintf(pClzFn, "%s.clz%i", pSrcFn, i);
-        sprintf(pUlzFn, "%s.ulz%i", pSrcFn, i);
-        cmpTime = lzCompressFile(pSrcFn, pClzFn, prec, level, i);
-        if (res == EXIT_FAILURE) return EXIT_FAILURE;
-        dcpTime = lzUncompressFile(pClzFn, pUlzFn, prec);
-        if (res == EXIT_FAILURE) return EXIT_FAILURE;
-        error = compareFiles(pSrcFn, pUlzFn, prec);
-        outSize = getFileSize(pClzFn);
-        //printf("%i\n", i);
-        if (error <= bound) 
-        {
-            printResults(pSrcFn, i, inSize, outSize, cmpTime, dcpTime, error);
-            break;
-        } else {
-            remove(pClzFn);
-            remove(pUlzFn);
-        }
-    }
+    sprintf(pClzFn, "%s.clz", pSrcFn);
+    sprintf(pUlzFn, "%s.ulz", pSrcFn);
+    cmpTime = lzCompressFile(pSrcFn, pClzFn, prec, level, bound, &protect);
+    if (res == EXIT_FAILURE) return EXIT_FAILURE;
+    dcpTime = lzUncompressFile(pClzFn, pUlzFn, prec);
+    if (res == EXIT_FAILURE) return EXIT_FAILURE;
+    error = compareFiles(pSrcFn, pUlzFn, prec);
+    outSize = getFileSize(pClzFn);
+    printResults(pSrcFn, protect, inSize, outSize, cmpTime, dcpTime, error);
 /* 
     cmpTime = compressFile(pSrcFn, pCmzFn, level);
     if (res == EXIT_FAILURE) return EXIT_FAILURE;
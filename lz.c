@@ -21,12 +21,23 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/time.h>
+#include <math.h>
+#define MINIZ_HEADER_FILE_ONLY
+#include "miniz.c"
 #include "lz.h"
 
+#define LZ_MODE_DEFAULT     (FORCE_COMP ? LZ_MODE_DEFLATE : LZ_MODE_ADAPTIVE)
 
-int lzCompress(uchar *dstBuf, ulong *outSize, uchar *srcBuf, ulong inSize, short level)
+
+
+ulong lzCompressBound(ulong inSize)
 {
-    *outSize = 2*inSize;
+    return mz_compressBound(inSize);
+}
+
+
+int lzCompress(uchar *dstBuf, ulong *outSize, uchar *srcBuf, ulong inSize, short level)
+{ // On entry *outSize is the capacity of dstBuf, see lzCompressBound
     return compress2(dstBuf, outSize, srcBuf, inSize, level);
 }
 
@@ -37,37 +48,384 @@ int lzUncompress(uchar *dstBuf, ulong *outSize, uchar *srcBuf, ulong inSize)
 }
 
 
-int entropyAnalysis(uchar *tmpBuf, ulong size)
+int lzDeflateDict(void *comp, uchar *dstBuf, ulong *outSize, uchar *srcBuf, ulong inSize, short level, const uchar *dict, ulong dictSize)
+{ // As lzDeflate, matches may reach back into the last 32 KB of dict, which the inflater must have in its window
+    size_t inLen = inSize, outLen = *outSize;
+    tdefl_status status;
+    mz_uint flags = TDEFL_COMPUTE_ADLER32 | tdefl_create_comp_flags_from_zip_params(level, MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+    if (tdefl_init((tdefl_compressor *)comp, NULL, NULL, flags) != TDEFL_STATUS_OKAY) return MZ_PARAM_ERROR;
+    if ((dictSize > 0) && (tdefl_set_dictionary((tdefl_compressor *)comp, dict, dictSize) != TDEFL_STATUS_OKAY)) return MZ_PARAM_ERROR;
+    status = tdefl_compress((tdefl_compressor *)comp, srcBuf, &inLen, dstBuf, &outLen, TDEFL_FINISH);
+    *outSize = outLen;
+    if (status == TDEFL_STATUS_DONE) return MZ_OK;
+    if (status == TDEFL_STATUS_OKAY) return MZ_BUF_ERROR;
+    return MZ_STREAM_ERROR;
+}
+
+
+int lzDeflate(void *comp, uchar *dstBuf, ulong *outSize, uchar *srcBuf, ulong inSize, short level)
+{ // Same stream as compress2, but on a compressor that is reset instead of allocated
+    return lzDeflateDict(comp, dstBuf, outSize, srcBuf, inSize, level, NULL, 0);
+}
+
+
+int lzInflate(void *decomp, uchar *dstBuf, ulong *outSize, uchar *srcBuf, ulong inSize)
+{ // Same as uncompress, but on a decompressor that is reset instead of allocated
+    size_t inLen = inSize, outLen = *outSize;
+    tinfl_status status;
+    mz_uint32 flags = TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF | TINFL_FLAG_COMPUTE_ADLER32;
+    tinfl_init((tinfl_decompressor *)decomp);
+    status = tinfl_decompress((tinfl_decompressor *)decomp, srcBuf, &inLen, dstBuf, dstBuf, &outLen, flags);
+    *outSize = outLen;
+    if (status == TINFL_STATUS_DONE) return MZ_OK;
+    if (status == TINFL_STATUS_HAS_MORE_OUTPUT) return MZ_BUF_ERROR;
+    return MZ_DATA_ERROR;
+}
+
+
+int lzOpenWindow(lzWindow *win, const uchar *srcBuf, ulong inSize)
+{ // Start a new deflate stream, the inflate state and the window are kept from a previous one
+    if (win->decomp == NULL) win->decomp = malloc(sizeof(tinfl_decompressor));
+    if (win->dict == NULL) win->dict = malloc(TINFL_LZ_DICT_SIZE);
+    if ((win->decomp == NULL) || (win->dict == NULL)) return EXIT_FAILURE;
+    tinfl_init((tinfl_decompressor *)win->decomp);
+    win->srcBuf = srcBuf;
+    win->inSize = inSize;
+    win->dictOfs = 0;
+    win->dictAvail = 0;
+    win->status = TINFL_STATUS_HAS_MORE_OUTPUT;
+    return EXIT_SUCCESS;
+}
+
+
+int lzPrimeWindow(lzWindow *win, const uchar *dict, ulong dictSize)
+{ // Right after lzOpenWindow, the stream then sees the end of dict as the output before its own
+    if (dictSize > TINFL_LZ_DICT_SIZE)
+    {
+        dict = dict + dictSize - TINFL_LZ_DICT_SIZE;
+        dictSize = TINFL_LZ_DICT_SIZE;
+    }
+    if ((win->dict == NULL) || (win->dictOfs != 0) || (win->dictAvail != 0)) return EXIT_FAILURE;
+    memcpy(win->dict, dict, dictSize);
+    win->dictOfs = dictSize & (TINFL_LZ_DICT_SIZE-1);
+    return EXIT_SUCCESS;
+}
+
+
+int lzCloseWindow(lzWindow *win)
+{
+    free(win->decomp);
+    free(win->dict);
+    win->decomp = NULL;
+    win->dict = NULL;
+    return EXIT_SUCCESS;
+}
+
+
+static int lzStepWindow(lzWindow *win, int last)
+{ // One tinfl call over the free part of the window, only called once everything was delivered
+    size_t inLen = win->inSize, outLen = TINFL_LZ_DICT_SIZE-win->dictOfs;
+    mz_uint32 flags = TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_COMPUTE_ADLER32;
+    if (!last) flags = flags | TINFL_FLAG_HAS_MORE_INPUT;
+    win->status = tinfl_decompress((tinfl_decompressor *)win->decomp, win->srcBuf, &inLen, win->dict, win->dict+win->dictOfs, &outLen, flags);
+    win->srcBuf = win->srcBuf + inLen;
+    win->inSize = win->inSize - inLen;
+    win->dictAvail = outLen;
+    win->dictOfs = (win->dictOfs+outLen) & (TINFL_LZ_DICT_SIZE-1);
+    if (win->status < TINFL_STATUS_DONE) return MZ_DATA_ERROR;
+    if ((win->status == TINFL_STATUS_NEEDS_MORE_INPUT) && (last)) return MZ_DATA_ERROR;
+    return MZ_OK;
+}
+
+
+int lzInflateWindow(lzWindow *win, uchar *dstBuf, ulong outSize, int drain, int last)
+{ // Deliver exactly outSize bytes of the stream; drain consumes the rest of the input, which must not hold more data
+    ulong n, outPos = 0;
+    while (outPos < outSize)
+    {
+        if (win->dictAvail > 0)
+        { // Inflated bytes are contiguous, tinfl never wraps within one call
+            n = win->dictAvail;
+            if (n > outSize-outPos) n = outSize-outPos;
+            memcpy(dstBuf+outPos, win->dict+((win->dictOfs-win->dictAvail) & (TINFL_LZ_DICT_SIZE-1)), n);
+            win->dictAvail = win->dictAvail - n;
+            outPos = outPos + n;
+            continue;
+        }
+        if (win->status == TINFL_STATUS_DONE) return MZ_DATA_ERROR;
+        if ((win->status == TINFL_STATUS_NEEDS_MORE_INPUT) && (win->inSize == 0)) return MZ_DATA_ERROR;
+        if (lzStepWindow(win, last) != MZ_OK) return MZ_DATA_ERROR;
+    }
+    while (drain)
+    {
+        if (win->dictAvail > 0) return MZ_DATA_ERROR;
+        if (win->status == TINFL_STATUS_DONE) return (win->inSize == 0) ? MZ_OK : MZ_DATA_ERROR;
+        if ((!last) && (win->status == TINFL_STATUS_NEEDS_MORE_INPUT) && (win->inSize == 0)) return MZ_OK;
+        if (lzStepWindow(win, last) != MZ_OK) return MZ_DATA_ERROR;
+    }
+    return MZ_OK;
+}
+
+
+lzContext *lzCreateContext(void)
+{
+    lzContext *ctx = calloc(1, sizeof(lzContext));
+    if (ctx == NULL) return NULL;
+    ctx->comp = malloc(sizeof(tdefl_compressor));
+    if (ctx->comp == NULL)
+    {
+        free(ctx);
+        return NULL;
+    }
+    ctx->mode = LZ_MODE_DEFAULT;
+    ctx->predictor = LZ_PRED_NONE;
+    ctx->quantizer = LZ_QUANT_TRUNCATE;
+    ctx->narrowing = LZ_NARROW_NEVER;
+    return ctx;
+}
+
+
+static void lzCopySettings(lzContext *dst, const lzContext *src)
+{ // The lzSelect* choices of a caller context, given to the contexts of its workers
+    dst->mode = src->mode;
+    dst->predictor = src->predictor;
+    dst->quantizer = src->quantizer;
+    dst->narrowing = src->narrowing;
+}
+
+
+int lzDestroyContext(lzContext *ctx)
+{
+    int i;
+    if (ctx == NULL) return EXIT_SUCCESS;
+    for (i = 0; i < 8; i++)
+    {
+        free(ctx->planes[i]);
+        free(ctx->dict[i]);
+    }
+    free(ctx->resBuf);
+    free(ctx->comp);
+    free(ctx);
+    return EXIT_SUCCESS;
+}
+
+
+int lzReserveContext(lzContext *ctx, ulong nbEle, ushort prec)
+{ // Planes only grow, so a context sized for the largest array allocates nothing more
+    int i;
+    uchar *buf;
+    if ((nbEle <= ctx->planeSize) && (prec <= ctx->nbPlanes)) return EXIT_SUCCESS;
+    if (nbEle < ctx->planeSize) nbEle = ctx->planeSize;
+    if (prec < ctx->nbPlanes) prec = ctx->nbPlanes;
+    for (i = 0; i < prec; i++)
+    {
+        buf = realloc(ctx->planes[i], nbEle);
+        if (buf == NULL) return EXIT_FAILURE;
+        ctx->planes[i] = buf;
+    }
+    ctx->planeSize = nbEle;
+    ctx->nbPlanes = prec;
+    return EXIT_SUCCESS;
+}
+
+
+lzDContext *lzCreateDContext(void)
+{
+    lzDContext *dctx = calloc(1, sizeof(lzDContext));
+    if (dctx == NULL) return NULL;
+    dctx->decomp = malloc(sizeof(tinfl_decompressor));
+    if (dctx->decomp == NULL)
+    {
+        free(dctx);
+        return NULL;
+    }
+    return dctx;
+}
+
+
+int lzDestroyDContext(lzDContext *dctx)
+{
+    int i;
+    if (dctx == NULL) return EXIT_SUCCESS;
+    for (i = 0; i < 8; i++)
+    {
+        free(dctx->planes[i]);
+        free(dctx->dict[i]);
+        lzCloseWindow(dctx->win+i);
+    }
+    free(dctx->decomp);
+    free(dctx);
+    return EXIT_SUCCESS;
+}
+
+
+int lzReserveDContext(lzDContext *dctx, ulong nbEle, ushort prec)
 {
-    ulong i = 0, code = 0, step = 1, max = 0, limit = size;
-    float byteStats[256];
+    int i;
+    uchar *buf;
+    if ((nbEle <= dctx->planeSize) && (prec <= dctx->nbPlanes)) return EXIT_SUCCESS;
+    if (nbEle < dctx->planeSize) nbEle = dctx->planeSize;
+    if (prec < dctx->nbPlanes) prec = dctx->nbPlanes;
+    for (i = 0; i < prec; i++)
+    {
+        buf = realloc(dctx->planes[i], nbEle);
+        if (buf == NULL) return EXIT_FAILURE;
+        dctx->planes[i] = buf;
+    }
+    dctx->planeSize = nbEle;
+    dctx->nbPlanes = prec;
+    return EXIT_SUCCESS;
+}
+
+
+static int lzSplitDictionary(uchar **dict, ulong *dictSize, ushort *dictPrec, const uchar *sample, ulong nbEle, ushort prec, short protect)
+{ // The planes of the last LZ_DICT_SIZE elements of sample, quantized as the arrays will be, no sample clears them
+    ulong i;
+    uchar *buf;
+    short lossy = (prec*8)-protect;
+    if ((sample != NULL) && (nbEle > 0) && ((prec < 1) || (prec > 8))) return EXIT_FAILURE;
+    if ((sample != NULL) && (nbEle > 0) && ((lossy < 0) || (lossy > (prec*8)))) return EXIT_FAILURE;
+    *dictSize = 0;
+    *dictPrec = 0;
+    if ((sample == NULL) || (nbEle == 0)) return EXIT_SUCCESS;
+    if (nbEle > LZ_DICT_SIZE)
+    {
+        sample = sample+((nbEle-LZ_DICT_SIZE)*prec);
+        nbEle = LZ_DICT_SIZE;
+    }
+    for (i = 0; i < prec; i++)
+    {
+        buf = realloc(dict[i], nbEle);
+        if (buf == NULL) return EXIT_FAILURE;
+        dict[i] = buf;
+    }
+    if (lzSplitQuantized(dict, sample, nbEle, prec, lossy, 0) != EXIT_SUCCESS) return EXIT_FAILURE; // Truncated, the decoder has no quantizer to match
+    *dictSize = nbEle;
+    *dictPrec = prec;
+    return EXIT_SUCCESS;
+}
+
+
+int lzSetDictionary(lzContext *ctx, const uchar *sample, ulong nbEle, ushort prec, short protect)
+{ // Every plane deflated with ctx gets the same plane of sample as history, a previous array or a trained one
+    return lzSplitDictionary(ctx->dict, &(ctx->dictSize), &(ctx->dictPrec), sample, nbEle, prec, protect);
+}
+
+
+int lzSetDDictionary(lzDContext *dctx, const uchar *sample, ulong nbEle, ushort prec, short protect)
+{ // Same sample and protect as given to lzSetDictionary
+    return lzSplitDictionary(dctx->dict, &(dctx->dictSize), &(dctx->dictPrec), sample, nbEle, prec, protect);
+}
+
+
+int lzSelectMode(lzContext *ctx, int mode)
+{ // LZ_MODE_DEFLATE deflates every plane kept, LZ_MODE_ADAPTIVE lets entropyAnalysis store noisy planes plain
+    if ((mode != LZ_MODE_DEFLATE) && (mode != LZ_MODE_ADAPTIVE)) mode = LZ_MODE_DEFAULT;
+    ctx->mode = mode;
+    return ctx->mode;
+}
+
+
+int lzSelectPredictor(lzContext *ctx, int pred)
+{ // Predictor of the containers written with ctx from now on, see lzpred.c
+    if ((pred < LZ_PRED_NONE) || (pred > LZ_PRED_LORENZO)) pred = LZ_PRED_NONE;
+    ctx->predictor = pred;
+    return ctx->predictor;
+}
+
+
+int lzSelectQuantizer(lzContext *ctx, int quant)
+{ // LZ_QUANT_ROUND rounds the dropped bits to nearest instead of truncating them, nothing changes for the decoder
+    if (quant != LZ_QUANT_ROUND) quant = LZ_QUANT_TRUNCATE;
+    ctx->quantizer = quant;
+    return ctx->quantizer;
+}
+
+
+int lzSelectNarrowing(lzContext *ctx, int narrow)
+{ // LZ_NARROW_FLOAT stores double arrays that all are floats as float planes, readers widen them back
+    // Off by default: the float byte planes deflate better on some fields and worse on many others,
+    // the zero low planes of such doubles already cost next to nothing
+    if (narrow != LZ_NARROW_FLOAT) narrow = LZ_NARROW_NEVER;
+    ctx->narrowing = narrow;
+    return ctx->narrowing;
+}
+
+
+int lzSplitQuantized(uchar **planes, const uchar *src, ulong n, ushort prec, short lossy, int round)
+{ // The dropped bits are cleared on the way to the planes, a cache sized block at a time
+    ulong block[QUANT_SIZE/sizeof(ulong)], i, nb, step = QUANT_SIZE/prec;
+    uchar *dst[8];
+    int j;
+    if (lossy == 0) return lzSplitPlanes(planes, src, n, prec);
+    for (i = 0; i < n; i = i+nb)
+    {
+        nb = (n-i < step) ? n-i : step;
+        if (lzQuantize((uchar *)block, src+(i*prec), nb, prec, lossy, round) != EXIT_SUCCESS) return EXIT_FAILURE;
+        for (j = 0; j < prec; j++) dst[j] = planes[j]+i;
+        lzSplitPlanes(dst, (uchar *)block, nb, prec);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+static void lzNarrow(uchar *dst, const uchar *daBuf, ulong first, ulong n, int transform)
+{ // Elements first to first+n of the caller's floats or doubles, in the narrower type of transform
+    if (transform & LZ_HALF_FROM_FLOAT) lzFloatToHalf((ushort *)dst, (const float *)daBuf+first, n);
+    else if (transform & LZ_BFLOAT_FROM_FLOAT) lzFloatToBFloat((ushort *)dst, (const float *)daBuf+first, n);
+    else lzDoubleToFloat((float *)dst, (const double *)daBuf+first, n);
+}
+
+
+static int lzSplitNarrowed(uchar **planes, const uchar *daBuf, ulong first, ulong n, ushort prec, int transform, short lossy, int round)
+{ // As lzSplitQuantized for elements narrowed to prec bytes, the conversion goes through the same cache sized blocks
+    ulong block[QUANT_SIZE/sizeof(ulong)], i, nb, step = QUANT_SIZE/prec;
+    uchar *dst[8];
+    int j;
+    for (i = 0; i < n; i = i+nb)
+    {
+        nb = (n-i < step) ? n-i : step;
+        lzNarrow((uchar *)block, daBuf, first+i, nb, transform);
+        if ((lossy > 0) && (lzQuantize((uchar *)block, (uchar *)block, nb, prec, lossy, round) != EXIT_SUCCESS)) return EXIT_FAILURE;
+        for (j = 0; j < prec; j++) dst[j] = planes[j]+i;
+        lzSplitPlanes(dst, (uchar *)block, nb, prec);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int entropyAnalysis(uchar *tmpBuf, ulong size, int code, short lossy)
+{ // Returns the code of the plane, 0 when its sampled entropy says deflate would not pay
+    unsigned int count[256], masked[256];
+    char preset[8] = {255, 254, 252, 248, 240, 224, 192, 128};
+    uchar *block, mask = (code == 2) ? preset[lossy%8] : 255;
+    ulong i, j, runs = 0, nbBlocks = 1, blockSize = size, step = 0;
+    double p, entropy = 0.0;
+    if ((code <= 0) || (size < 2)) return code;
     if (size > MAX_STATS)
-    { // Analyse maximum MAX_STATS bytes
-        step = size/MAX_STATS;
-        limit = MAX_STATS;
+    { // Analyse maximum MAX_STATS bytes, in STATS_BLOCKS runs spread over the plane
+        nbBlocks = STATS_BLOCKS;
+        blockSize = MAX_STATS/STATS_BLOCKS;
+        step = (size-blockSize)/(STATS_BLOCKS-1);
     }
-    for (i = 0; i < 256; i++) byteStats[i] = 0.0;
-    while (i < size)
-    { // Count how many ocurrences for each of the 256 options
-        byteStats[tmpBuf[i]] = byteStats[tmpBuf[i]] + 1;
-        i = i + step;
+    memset(masked, 0, sizeof(masked));
+    for (i = 0; i < nbBlocks; i++)
+    {
+        block = tmpBuf+(i*step);
+        lzHistogram(count, block, blockSize);
+        for (j = 0; j < 256; j++) masked[j & mask] = masked[j & mask] + count[j];
+        for (j = 1; j < blockSize; j++) runs = runs + ((block[j] & mask) == (block[j-1] & mask));
     }
     for (i = 0; i < 256; i++)
-    { // Convert counters into percentage and get percentage of the most frequent
-        byteStats[i] = (byteStats[i]*100.0)/limit;
-        if (byteStats[i] > max) max = byteStats[i];
-        //printf(" %3.1f ", byteStats[i]);
-    }
-    if (max >= BYTE_FREQ)
-    { // Convert maximum frequency to compression level (Not used now)
-        if (max >= MAX_LEVEL)
-        {
-            code = 9;
-        } else {
-            code = MAX_LEVEL - max;
-        }
+    { // Shannon entropy in bits per byte
+        if (masked[i] == 0) continue;
+        p = (double)masked[i]/(nbBlocks*blockSize);
+        entropy = entropy - (p*log2(p));
     }
-    return code;
+    // Order-0 entropy does not see runs, which deflate turns into matches almost for free
+    entropy = entropy*(1.0-((double)runs/(nbBlocks*(blockSize-1))));
+    if (VERBOSE) printf("Entropy : %f bits per byte\n", entropy);
+    return (entropy >= MAX_ENTROPY) ? 0 : code;
 }
 
 int getCode(int code[8], ushort prec, short lossy)
@@ -75,6 +433,7 @@ int getCode(int code[8], ushort prec, short lossy)
     int i;
     if (VERBOSE) printf("Lossy : %d  ", lossy);
     if (VERBOSE) printf(" -Byte compression layout: ");
+    for (i = 0; i < prec; i++) code[i] = 0;
     for (i = 0; i < prec; i++)
     {
         if ((lossy/8) >= (i+1))
@@ -100,7 +459,157 @@ int maskArray(uchar *tmpBuf, ulong offset, short lossy)
     return EXIT_SUCCESS;
 }
 
-int lzCompressFlopnt(
+static void lzPackIndices(uchar *dstBuf, uchar *tmpBuf, ulong offset, int bits, uchar *index)
+{ // Indices fill each byte from its low bits, as lzUnpackPlane reads them
+    ulong i;
+    int k, per = 8/bits;
+    uchar byte;
+    for (i = 0; i < offset; i = i + per)
+    {
+        byte = 0;
+        for (k = 0; (k < per) && (i+k < offset); k++) byte = byte | (index[tmpBuf[i+k]] << (k*bits));
+        *dstBuf++ = byte;
+    }
+}
+
+int lzEncodePlane(uchar *dstBuf, ulong *outSize, uchar *tmpBuf, ulong offset, int code)
+{ // Returns 3 for a constant plane, 4 for a plane of few symbols, else code and nothing is written
+    uchar dict[MAX_SYMBOLS], index[256];
+    ulong i, runs = 1, size;
+    int bits, nbSym = 1;
+    if ((code <= 0) || (offset == 0)) return code;
+    memset(index, 255, sizeof(index));
+    dict[0] = tmpBuf[0];
+    index[tmpBuf[0]] = 0;
+    for (i = 1; i < offset; i++)
+    { // Stops at the first symbol too many, so noisy planes are left after a few bytes
+        if (tmpBuf[i] == tmpBuf[i-1]) continue;
+        runs = runs + 1;
+        if (index[tmpBuf[i]] != 255) continue;
+        if (nbSym == MAX_SYMBOLS) return code;
+        index[tmpBuf[i]] = nbSym;
+        dict[nbSym++] = tmpBuf[i];
+    }
+    if (nbSym == 1)
+    { // Constant plane, one byte
+        if (*outSize < 1) return code;
+        dstBuf[0] = dict[0];
+        *outSize = 1;
+        return 3;
+    }
+    bits = (nbSym <= 2) ? 1 : ((nbSym <= 4) ? 2 : 4);
+    if (runs*RUN_BITS < offset*bits) return code; // Long runs, deflate turns them into matches
+    size = 1+nbSym+(((offset*bits)+7)/8);
+    if (size > *outSize) return code;
+    dstBuf[0] = nbSym;
+    memcpy(dstBuf+1, dict, nbSym);
+    lzPackIndices(dstBuf+1+nbSym, tmpBuf, offset, bits, index);
+    *outSize = size;
+    return 4;
+}
+
+int lzDecodePlane(uchar *dstBuf, uchar *srcBuf, ulong parSize, ulong first, ulong n, int code)
+{ // Elements [first, first+n) of a code 3, code 4 (nbSym, dict[nbSym], packed indices) or plain code 5 plane
+    uchar dict[16];
+    int bits, nbSym;
+    if (parSize < 1) return EXIT_FAILURE;
+    if (code == 3)
+    {
+        memset(dstBuf, srcBuf[0], n);
+        return EXIT_SUCCESS;
+    }
+    if (code == 5)
+    { // Deflated code 5 planes go through lzDecodeBits
+        if ((parSize < 2) || (srcBuf[1] != 0)) return EXIT_FAILURE;
+        if (parSize < 2+((((first+n)*srcBuf[0])+7)/8)) return EXIT_FAILURE;
+        return lzUnpackBits(dstBuf, srcBuf+2, first, n, srcBuf[0]);
+    }
+    nbSym = srcBuf[0];
+    if ((code != 4) || (nbSym < 2) || (nbSym > MAX_SYMBOLS)) return EXIT_FAILURE;
+    bits = (nbSym <= 2) ? 1 : ((nbSym <= 4) ? 2 : 4);
+    if (parSize < 1+nbSym+((((first+n)*bits)+7)/8)) return EXIT_FAILURE;
+    memset(dict, 0, sizeof(dict));
+    memcpy(dict, srcBuf+1, nbSym);
+    return lzUnpackPlane(dstBuf, srcBuf+1+nbSym, first, n, bits, dict);
+}
+
+int lzEncodeBits(void *comp, uchar *dstBuf, ulong *outSize, uchar *tmpBuf, ulong offset, int bits, int code, short level)
+{ // Code 5: bits, deflated, then the kept bits of a code 2 plane packed (in place in tmpBuf) and deflated unless code is 0
+    ulong parSize, size = ((offset*bits)+7)/8;
+    int r;
+    if (*outSize < 2) return EXIT_FAILURE;
+    lzPackBits(tmpBuf, tmpBuf, offset, bits);
+    dstBuf[0] = bits;
+    dstBuf[1] = 0;
+    if (code > 0)
+    { // Deflate has to beat the packed bytes
+        parSize = (*outSize-2 < size) ? *outSize-2 : size;
+        r = lzDeflate(comp, dstBuf+2, &parSize, tmpBuf, size, level);
+        if (r == MZ_OK)
+        {
+            dstBuf[1] = 1;
+            *outSize = 2+parSize;
+            return EXIT_SUCCESS;
+        }
+        if (r != MZ_BUF_ERROR) return EXIT_FAILURE;
+    }
+    if (2+size > *outSize) return EXIT_FAILURE;
+    memcpy(dstBuf+2, tmpBuf, size);
+    *outSize = 2+size;
+    return EXIT_SUCCESS;
+}
+
+int lzDecodeBits(void *decomp, uchar *dstBuf, uchar *srcBuf, ulong parSize, ulong n)
+{ // A whole code 5 plane, deflated bits are inflated at the end of dstBuf and unpacked forward over themselves
+    ulong size, outSize;
+    if (parSize < 2) return EXIT_FAILURE;
+    if (srcBuf[1] == 0) return lzDecodePlane(dstBuf, srcBuf, parSize, 0, n, 5);
+    if ((srcBuf[0] < 1) || (srcBuf[0] > 7)) return EXIT_FAILURE;
+    size = ((n*srcBuf[0])+7)/8;
+    outSize = size;
+    if ((lzInflate(decomp, dstBuf+n-size, &outSize, srcBuf+2, parSize-2) != MZ_OK) || (outSize != size)) return EXIT_FAILURE;
+    return lzUnpackBits(dstBuf, dstBuf+n-size, 0, n, srcBuf[0]);
+}
+
+ulong lzCompressFlopntBound(ulong offset, ushort prec, short lossy)
+{ // Header, then for each plane its code, its size and at most mz_compressBound bytes
+    int i, code[8];
+    ulong bound = sizeof(ulong)+sizeof(short);
+    getCode(code, prec, lossy);
+    for (i = 0; i < prec; i++)
+    {
+        bound = bound + sizeof(int) + sizeof(ulong);
+        if (code[i] >= 0) bound = bound + mz_compressBound(offset);
+    }
+    return bound;
+}
+
+
+int lzCompressPlane(void *comp, uchar *dstBuf, ulong *parSize, uchar *tmpBuf, ulong offset, int code, int pack, short level, short lossy, const uchar *dict, ulong dictSize)
+{ // On entry *parSize is the room left in dstBuf, returns the code the plane is written with or -1
+    ulong room = *parSize;
+    int r, bits = 8-(lossy%8);
+    code = lzEncodePlane(dstBuf, parSize, tmpBuf, offset, code);
+    if ((pack) && ((code < 3) || ((code == 4) && (*parSize > 2+(((offset*bits)+7)/8)))))
+    { // Few bits kept, only those are stored unless code 4 packs them tighter
+        *parSize = room;
+        return (lzEncodeBits(comp, dstBuf, parSize, tmpBuf, offset, bits, code, level) == EXIT_SUCCESS) ? 5 : -1;
+    }
+    if (code >= 3) return code;
+    if (*parSize > mz_compressBound(offset)) *parSize = mz_compressBound(offset);
+    r = lzDeflateDict(comp, dstBuf, parSize, tmpBuf, offset, level, dict, dictSize);
+    if ((r == MZ_BUF_ERROR) && (offset <= room))
+    { // Deflate output does not fit, write the bytes plain
+        memcpy(dstBuf, tmpBuf, offset);
+        *parSize = offset;
+        return 0;
+    }
+    return (r < 0) ? -1 : code;
+}
+
+
+int lzCompressFlopntCtx(
+        lzContext *ctx,
         uchar *dstBuf, 
         ulong *outSize, 
         uchar **tmpBuf, 
@@ -108,15 +617,16 @@ int lzCompressFlopnt(
         ushort prec, 
         short level, 
         short lossy )
-{
+{ // On entry *outSize is the capacity of dstBuf, on success the size written, the planes come from lzSplitQuantized
     struct timeval start, end;
-    ulong finalSize;
+    ulong finalSize, parSize, capacity = *outSize, byteCount = offset*prec;
     float t0 = 0, t1 = 0, t2 = 0;
-    int i, code[8];
-    if ((prec != 4) && (prec != 8)) return EXIT_FAILURE;
+    int i, pack, code[8], bits = 8-(lossy%8);
+    if ((prec < 1) || (prec > 8)) return EXIT_FAILURE;
     if ((level < 1) || (level > MAX_LEVEL)) return EXIT_FAILURE;
     if ((lossy < 0) || (lossy > (prec*8))) return EXIT_FAILURE;
-    memcpy(dstBuf, outSize, sizeof(ulong));
+    if (capacity < sizeof(ulong)+sizeof(short)) return EXIT_FAILURE;
+    memcpy(dstBuf, &byteCount, sizeof(ulong));
     finalSize = sizeof(ulong);
     memcpy(dstBuf+finalSize, &lossy, sizeof(short));
     finalSize = finalSize + sizeof(short);
@@ -124,39 +634,33 @@ int lzCompressFlopnt(
     for (i = 0; i < prec; i++)
     {
         gettimeofday(&start, NULL);
-        if (!FORCE_COMP) code[i] = entropyAnalysis(tmpBuf[i], offset);
+        pack = (code[i] == 2) && (bits <= PACK_BITS);
+        if (ctx->mode == LZ_MODE_ADAPTIVE) code[i] = entropyAnalysis(tmpBuf[i], offset, code[i], lossy);
         gettimeofday(&end, NULL);
         t0 = t0 + (end.tv_sec-start.tv_sec)+((end.tv_usec-start.tv_usec)/1000000.0);
+        if (finalSize+sizeof(int)+sizeof(ulong) > capacity) return EXIT_FAILURE;
         memcpy(dstBuf+finalSize, code+i, sizeof(int));
         finalSize = finalSize + sizeof(int);
-        if (code[i] > 0)
-        { // Bytes that need to be compressed
-            if (code[i] == 2) maskArray(tmpBuf[i], offset, lossy);
+        if ((code[i] > 0) || (pack))
+        { // Bytes that need to be compressed, deflated in place after the size field
             gettimeofday(&start, NULL);
-            uchar *xtrBuf = malloc(2*offset);
-            *outSize = 2*offset;
-            memset(xtrBuf, 0, offset);
-            int r = lzCompress(xtrBuf, outSize, tmpBuf[i], offset, level);
-            //if (VERBOSE) printf(": %d, ", r);
-            if (r < 0) return EXIT_FAILURE;
-            memcpy(dstBuf+finalSize, outSize, sizeof(ulong));
-            finalSize = finalSize + sizeof(ulong);
-            memcpy(dstBuf+finalSize, xtrBuf, *outSize);
-            finalSize = finalSize + *outSize;
-            free(xtrBuf);
+            parSize = capacity-finalSize-sizeof(ulong);
+            code[i] = lzCompressPlane(ctx->comp, dstBuf+finalSize+sizeof(ulong), &parSize, tmpBuf[i], offset, code[i], pack, level, lossy, ctx->dict[i], ctx->dictSize);
+            if (code[i] < 0) return EXIT_FAILURE;
+            memcpy(dstBuf+finalSize-sizeof(int), code+i, sizeof(int));
+            memcpy(dstBuf+finalSize, &parSize, sizeof(ulong));
+            finalSize = finalSize + sizeof(ulong) + parSize;
             gettimeofday(&end, NULL);
             t1 = t1 + (end.tv_sec-start.tv_sec)+((end.tv_usec-start.tv_usec)/1000000.0);
         } else {
             gettimeofday(&start, NULL);
+            memcpy(dstBuf+finalSize, &offset, sizeof(ulong));
+            finalSize = finalSize + sizeof(ulong);
             if (code[i] == 0)
             { // Bytes that are writen plain
-                memcpy(dstBuf+finalSize, &offset, sizeof(ulong));
-                finalSize = finalSize + sizeof(ulong);
+                if (finalSize+offset > capacity) return EXIT_FAILURE;
                 memcpy(dstBuf+finalSize, tmpBuf[i], offset);
                 finalSize = finalSize + offset;
-            } else { // Bytes that are lost
-                memcpy(dstBuf+finalSize, &offset, sizeof(ulong));
-                finalSize = finalSize + sizeof(ulong);
             }
             gettimeofday(&end, NULL);
             t2 = t2 + (end.tv_sec-start.tv_sec)+((end.tv_usec-start.tv_usec)/1000000.0);
@@ -168,7 +672,134 @@ int lzCompressFlopnt(
 }
 
 
-int lzUncompressFlopnt(uchar **tmpBuf, ulong offset, uchar *srcBuf, ulong inSize, ushort size)
+int lzCompressFlopnt(uchar *dstBuf, ulong *outSize, uchar **tmpBuf, ulong offset, ushort prec, short level, short lossy)
+{ // Planes split without lzSplitQuantized, the partly dropped one is masked here
+    int i, res, code[8];
+    lzContext *ctx = lzCreateContext();
+    if (ctx == NULL) return EXIT_FAILURE;
+    getCode(code, prec, lossy);
+    for (i = 0; i < prec; i++) if (code[i] == 2) maskArray(tmpBuf[i], offset, lossy);
+    res = lzCompressFlopntCtx(ctx, dstBuf, outSize, tmpBuf, offset, prec, level, lossy);
+    lzDestroyContext(ctx);
+    return res;
+}
+
+
+typedef struct lzPlaneJob
+{
+    lzContext **ctx;
+    lzContext *owner;
+    uchar **tmpBuf;
+    uchar *xtrBuf[8];
+    ulong xtrSize[8];
+    ulong offset;
+    int code[8];
+    int pack[8];
+    int status[8];
+    short level;
+    short lossy;
+} lzPlaneJob;
+
+
+void lzCompressPlaneTask(void *arg, int i, int worker)
+{
+    lzPlaneJob *job = arg;
+    int code;
+    if ((job->code[i] <= 0) && (!job->pack[i])) return;
+    job->xtrSize[i] = mz_compressBound(job->offset);
+    job->xtrBuf[i] = malloc(job->xtrSize[i]);
+    if (job->xtrBuf[i] == NULL)
+    {
+        job->status[i] = -1;
+        return;
+    }
+    code = lzCompressPlane(job->ctx[worker]->comp, job->xtrBuf[i], job->xtrSize+i, job->tmpBuf[i], job->offset, job->code[i], job->pack[i], job->level, job->lossy, job->owner->dict[i], job->owner->dictSize);
+    if (code < 0) job->status[i] = -1;
+    else job->code[i] = code;
+}
+
+
+int lzCompressFlopntMT(
+        lzContext *ctx,
+        uchar *dstBuf,
+        ulong *outSize,
+        uchar **tmpBuf,
+        ulong offset,
+        ushort prec,
+        short level,
+        short lossy,
+        int nbThreads )
+{ // Same bytes as lzCompressFlopntCtx, the planes are compressed concurrently with the mode and dictionary of ctx
+    lzPlaneJob job;
+    ulong finalSize, parSize, capacity = *outSize, byteCount = offset*prec;
+    int i, code[8], res = EXIT_SUCCESS;
+    if ((prec < 1) || (prec > 8)) return EXIT_FAILURE;
+    if ((level < 1) || (level > MAX_LEVEL)) return EXIT_FAILURE;
+    if ((lossy < 0) || (lossy > (prec*8))) return EXIT_FAILURE;
+    memset(&job, 0, sizeof(lzPlaneJob));
+    job.owner = ctx;
+    job.tmpBuf = tmpBuf;
+    job.offset = offset;
+    job.level = level;
+    job.lossy = lossy;
+    getCode(job.code, prec, lossy);
+    for (i = 0; i < prec; i++) job.pack[i] = (job.code[i] == 2) && (8-(lossy%8) <= PACK_BITS);
+    if (ctx->mode == LZ_MODE_ADAPTIVE) for (i = 0; i < prec; i++) job.code[i] = entropyAnalysis(tmpBuf[i], offset, job.code[i], lossy);
+    memcpy(code, job.code, sizeof(code));
+    if (nbThreads < 1) nbThreads = 1;
+    if (nbThreads > prec) nbThreads = prec;
+    job.ctx = calloc(nbThreads, sizeof(lzContext *));
+    if (job.ctx == NULL) return EXIT_FAILURE;
+    for (i = 0; i < nbThreads; i++) if ((job.ctx[i] = lzCreateContext()) == NULL) res = EXIT_FAILURE;
+    if (res == EXIT_SUCCESS) lzParallelFor(nbThreads, prec, lzCompressPlaneTask, &job);
+    for (i = 0; i < nbThreads; i++) lzDestroyContext(job.ctx[i]);
+    free(job.ctx);
+    if (capacity < sizeof(ulong)+sizeof(short)) res = EXIT_FAILURE;
+    if (res == EXIT_SUCCESS)
+    {
+        memcpy(dstBuf, &byteCount, sizeof(ulong));
+        memcpy(dstBuf+sizeof(ulong), &lossy, sizeof(short));
+    }
+    finalSize = sizeof(ulong)+sizeof(short);
+    for (i = 0; i < prec; i++)
+    { // Planes are written in order, exactly as the serial path does
+        if ((res == EXIT_SUCCESS) && (job.status[i] == 0) && (job.code[i] > 0) && (job.code[i] != 5) && (finalSize+sizeof(int)+sizeof(ulong) <= capacity) && (finalSize+sizeof(int)+sizeof(ulong)+job.xtrSize[i] > capacity))
+        { // The worker output does not fit, it is encoded again in the room left as the serial path does, code 5 has packed the plane in place
+            job.xtrSize[i] = capacity-finalSize-sizeof(int)-sizeof(ulong);
+            job.code[i] = lzCompressPlane(ctx->comp, dstBuf+finalSize+sizeof(int)+sizeof(ulong), job.xtrSize+i, tmpBuf[i], offset, code[i], job.pack[i], level, lossy, ctx->dict[i], ctx->dictSize);
+            job.status[i] = (job.code[i] < 0) ? -1 : 0;
+            free(job.xtrBuf[i]);
+            job.xtrBuf[i] = NULL;
+        }
+        if (job.status[i] < 0) res = EXIT_FAILURE;
+        parSize = (job.code[i] > 0) ? job.xtrSize[i] : ((job.code[i] == 0) ? offset : 0);
+        if (finalSize+sizeof(int)+sizeof(ulong)+parSize > capacity) res = EXIT_FAILURE;
+        if (res == EXIT_FAILURE) continue;
+        memcpy(dstBuf+finalSize, job.code+i, sizeof(int));
+        finalSize = finalSize + sizeof(int);
+        if (job.code[i] > 0)
+        { // Bytes that need to be compressed
+            memcpy(dstBuf+finalSize, job.xtrSize+i, sizeof(ulong));
+            finalSize = finalSize + sizeof(ulong);
+            if (job.xtrBuf[i] != NULL) memcpy(dstBuf+finalSize, job.xtrBuf[i], job.xtrSize[i]);
+            finalSize = finalSize + job.xtrSize[i];
+        } else {
+            memcpy(dstBuf+finalSize, &offset, sizeof(ulong));
+            finalSize = finalSize + sizeof(ulong);
+            if (job.code[i] == 0)
+            { // Bytes that are writen plain
+                memcpy(dstBuf+finalSize, tmpBuf[i], offset);
+                finalSize = finalSize + offset;
+            }
+        }
+    }
+    for (i = 0; i < prec; i++) free(job.xtrBuf[i]);
+    if (res == EXIT_SUCCESS) *outSize = finalSize;
+    return res;
+}
+
+
+int lzUncompressFlopntCtx(lzDContext *dctx, uchar **tmpBuf, ulong offset, uchar *srcBuf, ulong inSize, ushort size)
 {
     short lossy, i;
     int code[8];
@@ -179,14 +810,23 @@ int lzUncompressFlopnt(uchar **tmpBuf, ulong offset, uchar *srcBuf, ulong inSize
     for (i = 0; i < size; i++)
     {
         outSize = offset;
+        if (finalSize+sizeof(int)+sizeof(ulong) > inSize) return EXIT_FAILURE;
         memcpy(code+i, srcBuf+finalSize, sizeof(int));
         finalSize = finalSize + sizeof(int);
         if (VERBOSE) printf("%d ", code[i]);
         memcpy(&parSize, srcBuf+finalSize, sizeof(ulong));
         finalSize = finalSize + sizeof(ulong);
-        if (code[i] > 0)
+        if ((code[i] <= 0) && (parSize != offset)) return EXIT_FAILURE;
+        if ((code[i] >= 0) && (parSize > inSize-finalSize)) return EXIT_FAILURE;
+        if (code[i] == 5)
         {
-            lzUncompress(tmpBuf[i], &outSize, srcBuf+finalSize, parSize);
+            if (lzDecodeBits(dctx->decomp, tmpBuf[i], srcBuf+finalSize, parSize, offset) != EXIT_SUCCESS) return EXIT_FAILURE;
+            finalSize = finalSize + parSize;
+        } else if (code[i] >= 3) {
+            if (lzDecodePlane(tmpBuf[i], srcBuf+finalSize, parSize, 0, offset, code[i]) != EXIT_SUCCESS) return EXIT_FAILURE;
+            finalSize = finalSize + parSize;
+        } else if (code[i] > 0) {
+            if ((lzInflate(dctx->decomp, tmpBuf[i], &outSize, srcBuf+finalSize, parSize) != MZ_OK) || (outSize != offset)) return EXIT_FAILURE;
             finalSize = finalSize + parSize;
         } else {
             if (code[i] == 0) {
@@ -198,104 +838,1236 @@ int lzUncompressFlopnt(uchar **tmpBuf, ulong offset, uchar *srcBuf, ulong inSize
         }
     }
     if (VERBOSE) printf("\n");
-    if (finalSize != inSize) printf("Error while decoding array!\n");
+    if (finalSize != inSize)
+    {
+        printf("Error while decoding array!\n");
+        return EXIT_FAILURE;
+    }
     return EXIT_SUCCESS;
 }
 
 
-int lzCompressFloat(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short protect)
+int lzUncompressFlopnt(uchar **tmpBuf, ulong offset, uchar *srcBuf, ulong inSize, ushort size)
 {
-    lfloat lfBuf;
-    uchar *tmpBuf[4];
-    ushort j, size = sizeof(float);
-    ulong i, offset = daSize;
-    *outSize = offset*size;
-    short lossy = (sizeof(float)*8)-protect;
-    for (i = 0; i < size; i++) tmpBuf[i] = malloc(offset);
-    for (i = 0; i < daSize; i++)
-    {
-        lfBuf.value = darBuf[i];
-        for (j = 0; j < size; j++) memcpy(tmpBuf[j]+(i*sizeof(char)), &(lfBuf.byte[j]), sizeof(char));
-    }
-    lzCompressFlopnt(dstBuf, outSize, tmpBuf, offset, size, level, lossy);
-    for (i = 0; i < size; i++) free(tmpBuf[i]);
-    return EXIT_SUCCESS;
+    int res;
+    lzDContext *dctx = lzCreateDContext();
+    if (dctx == NULL) return EXIT_FAILURE;
+    res = lzUncompressFlopntCtx(dctx, tmpBuf, offset, srcBuf, inSize, size);
+    lzDestroyDContext(dctx);
+    return res;
 }
 
 
-int lzUncompressFloat(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+typedef struct lzPlaneSrc
 {
-    lfloat lfBuf;
-    uchar *tmpBuf[4];
-    ushort j, size = sizeof(float);
-    ulong i, offset;
+    lzDContext **dctx;
+    uchar **tmpBuf;
+    uchar *srcBuf;
+    ulong offset;
+    ulong parSize[8];
+    ulong parOffset[8];
+    int code[8];
+    int status[8];
+} lzPlaneSrc;
 
-    memcpy(&offset, srcBuf, sizeof(ulong));
-    offset = offset/size;
-    *darSize = offset;
-    for (i = 0; i < size; i++) tmpBuf[i] = malloc(offset);
-    lzUncompressFlopnt(tmpBuf, offset, srcBuf, inSize, size);
-    for (i = 0; i < *darSize; i++)
+
+void lzUncompressPlaneTask(void *arg, int i, int worker)
+{
+    lzPlaneSrc *job = arg;
+    ulong outSize = job->offset;
+    if (job->code[i] == 5)
     {
-        for (j = 0; j < size; j++) memcpy(&(lfBuf.byte[j]), tmpBuf[j]+(i*sizeof(char)), sizeof(char));
-        darBuf[i] = lfBuf.value;
+        job->status[i] = (lzDecodeBits(job->dctx[worker]->decomp, job->tmpBuf[i], job->srcBuf+job->parOffset[i], job->parSize[i], job->offset) == EXIT_SUCCESS) ? 0 : -1;
+    } else if (job->code[i] >= 3) {
+        job->status[i] = (lzDecodePlane(job->tmpBuf[i], job->srcBuf+job->parOffset[i], job->parSize[i], 0, job->offset, job->code[i]) == EXIT_SUCCESS) ? 0 : -1;
+    } else if (job->code[i] > 0) {
+        job->status[i] = lzInflate(job->dctx[worker]->decomp, job->tmpBuf[i], &outSize, job->srcBuf+job->parOffset[i], job->parSize[i]);
+        if ((job->status[i] == MZ_OK) && (outSize != job->offset)) job->status[i] = -1;
+    } else {
+        if (job->code[i] == 0) {
+            memcpy(job->tmpBuf[i], job->srcBuf+job->parOffset[i], job->parSize[i]);
+        } else {
+            memset(job->tmpBuf[i], 0, job->parSize[i]);
+        }
     }
-    for (i = 0; i < size; i++) free(tmpBuf[i]);
-    return EXIT_SUCCESS;
 }
 
 
-int lzCompressDouble(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short protect)
-{
-    float t0, t1;
-    ldouble ldBuf;
-    uchar *tmpBuf[8];
-    struct timeval start, end;
-    short lossy = (sizeof(double)*8) - protect;
-    ushort j, sChar = sizeof(char), size = sizeof(double);
-    ulong i, offset = daSize;
-    *outSize = offset*size;
-
-    if (sChar != 1) return EXIT_FAILURE;
-    gettimeofday(&start, NULL);
-    for (i = 0; i < size; i++) tmpBuf[i] = malloc(offset);
-    for (i = 0; i < daSize; i++)
+int lzUncompressFlopntMT(uchar **tmpBuf, ulong offset, uchar *srcBuf, ulong inSize, ushort size, int nbThreads)
+{ // Same layout as lzUncompressFlopnt, the planes are located first and inflated concurrently
+    lzPlaneSrc job;
+    ulong finalSize = sizeof(ulong)+sizeof(short);
+    int i;
+    memset(&job, 0, sizeof(lzPlaneSrc));
+    job.tmpBuf = tmpBuf;
+    job.srcBuf = srcBuf;
+    job.offset = offset;
+    for (i = 0; i < size; i++)
+    { // Header walk, no data is touched
+        if (finalSize+sizeof(int)+sizeof(ulong) > inSize) return EXIT_FAILURE;
+        memcpy(job.code+i, srcBuf+finalSize, sizeof(int));
+        finalSize = finalSize + sizeof(int);
+        memcpy(job.parSize+i, srcBuf+finalSize, sizeof(ulong));
+        finalSize = finalSize + sizeof(ulong);
+        job.parOffset[i] = finalSize;
+        if (job.code[i] >= 0) finalSize = finalSize + job.parSize[i];
+        if ((job.code[i] <= 0) && (job.parSize[i] != offset)) return EXIT_FAILURE;
+    }
+    if (finalSize != inSize)
     {
-        ldBuf.value = daBuf[i];
-        for (j = 0; j < size; j++) memcpy(tmpBuf[j]+i, &(ldBuf.byte[j]), sizeof(char));
-        //for (j = 0; j < size; j++) tmpBuf[j][i] = ldBuf.byte[j];
+        printf("Error while decoding array!\n");
+        return EXIT_FAILURE;
     }
-    gettimeofday(&end, NULL);
-    t0 = end.tv_sec-start.tv_sec+((end.tv_usec-start.tv_usec)/1000000.0);
-    gettimeofday(&start, NULL);
-    lzCompressFlopnt(dstBuf, outSize, tmpBuf, offset, size, level, lossy);
-    gettimeofday(&end, NULL);
-    t1 = end.tv_sec-start.tv_sec+((end.tv_usec-start.tv_usec)/1000000.0);
-    if (VERBOSE) printf("Reformatting time: %f, compression time : %f \n", t0, t1);
-    for (i = 0; i < size; i++) free(tmpBuf[i]);
+    if (nbThreads < 1) nbThreads = 1;
+    if (nbThreads > size) nbThreads = size;
+    job.dctx = calloc(nbThreads, sizeof(lzDContext *));
+    if (job.dctx == NULL) return EXIT_FAILURE;
+    for (i = 0; i < nbThreads; i++) if ((job.dctx[i] = lzCreateDContext()) == NULL) job.status[0] = -1;
+    if (job.status[0] == 0) lzParallelFor(nbThreads, size, lzUncompressPlaneTask, &job);
+    for (i = 0; i < nbThreads; i++) lzDestroyDContext(job.dctx[i]);
+    free(job.dctx);
+    for (i = 0; i < size; i++) if (job.status[i] < 0) return EXIT_FAILURE;
     return EXIT_SUCCESS;
 }
 
 
-int lzUncompressDouble(double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
-{
-    ldouble ldBuf;
-    uchar *tmpBuf[8];
-    ushort j, size = sizeof(double);
-    ulong i, offset;
+int lzUncompressLockstepRange(lzDContext *dctx, uchar *daBuf, uchar *srcBuf, ulong inSize, ushort prec, ulong first, ulong count)
+{ // Inflate all planes window by window and interleave elements [first, first+count) straight into daBuf
+    uchar *planes[8], *window[8], *packed[8];
+    ulong i, pos, nb, lo, hi, size, offset, parSize, finalSize, end = first+count, packedSize[8];
+    int code[8], streamed[8];
 
+    if (inSize < sizeof(ulong)+sizeof(short)) return EXIT_FAILURE;
     memcpy(&offset, srcBuf, sizeof(ulong));
-    offset = offset/size;
-    *darSize = offset;
-    for (i = 0; i < size; i++) tmpBuf[i] = malloc(offset);
-    lzUncompressFlopnt(tmpBuf, offset, srcBuf, inSize, size);
-    for (i = 0; i < *darSize; i++)
-    {
-        for (j = 0; j < size; j++) memcpy(&(ldBuf.byte[j]), tmpBuf[j]+(i*sizeof(char)), sizeof(char));
-        daBuf[i] = ldBuf.value;
+    offset = offset/prec;
+    if ((first > offset) || (count > offset-first)) return EXIT_FAILURE;
+    if (lzReserveDContext(dctx, WINDOW_SIZE, prec) != EXIT_SUCCESS) return EXIT_FAILURE;
+    finalSize = sizeof(ulong)+sizeof(short);
+    for (i = 0; i < prec; i++)
+    { // Header walk, every plane gets its own inflate state over its own part of srcBuf
+        if (finalSize+sizeof(int)+sizeof(ulong) > inSize) return EXIT_FAILURE;
+        memcpy(code+i, srcBuf+finalSize, sizeof(int));
+        finalSize = finalSize + sizeof(int);
+        memcpy(&parSize, srcBuf+finalSize, sizeof(ulong));
+        finalSize = finalSize + sizeof(ulong);
+        if ((code[i] <= 0) && (parSize != offset)) return EXIT_FAILURE;
+        planes[i] = dctx->planes[i];
+        streamed[i] = (code[i] > 0) && (code[i] < 3);
+        if (code[i] < 0)
+        { // Bytes that are lost, the plane stays zero for all the windows
+            memset(dctx->planes[i], 0, WINDOW_SIZE);
+            continue;
+        }
+        if (parSize > inSize-finalSize) return EXIT_FAILURE;
+        if (code[i] == 0) planes[i] = srcBuf+finalSize;
+        packed[i] = srcBuf+finalSize;
+        packedSize[i] = parSize;
+        if ((code[i] == 3) && (lzDecodePlane(dctx->planes[i], packed[i], parSize, 0, WINDOW_SIZE, 3) != EXIT_SUCCESS)) return EXIT_FAILURE;
+        if (code[i] == 5)
+        { // Plain bits are unpacked where elements are delivered, deflated ones are inflated with the windows
+            if ((parSize < 2) || (packed[i][0] < 1) || (packed[i][0] > 7) || (packed[i][1] > 1)) return EXIT_FAILURE;
+            streamed[i] = packed[i][1];
+        }
+        if ((code[i] == 5) && (streamed[i]) && (lzOpenWindow(dctx->win+i, srcBuf+finalSize+2, parSize-2) != EXIT_SUCCESS)) return EXIT_FAILURE;
+        if ((code[i] < 3) && (streamed[i]) && (lzOpenWindow(dctx->win+i, srcBuf+finalSize, parSize) != EXIT_SUCCESS)) return EXIT_FAILURE;
+        if ((code[i] < 3) && (streamed[i]) && (dctx->dictSize > 0) && (lzPrimeWindow(dctx->win+i, dctx->dict[i], dctx->dictSize) != EXIT_SUCCESS)) return EXIT_FAILURE;
+        finalSize = finalSize + parSize;
+    }
+    if (finalSize != inSize)
+    {
+        printf("Error while decoding array!\n");
+        return EXIT_FAILURE;
+    }
+    for (pos = 0; pos < end; pos = pos + nb)
+    { // Windows before first are inflated and dropped, decoding stops with the window holding the last element
+        nb = offset-pos;
+        if (nb > WINDOW_SIZE) nb = WINDOW_SIZE;
+        lo = (first > pos) ? first : pos;
+        hi = (end < pos+nb) ? end : pos+nb;
+        for (i = 0; i < prec; i++)
+        { // Packed planes are only unpacked where elements are delivered
+            if (((code[i] == 4) || ((code[i] == 5) && (!streamed[i]))) && (lo < hi) && (lzDecodePlane(dctx->planes[i]+(lo-pos), packed[i], packedSize[i], lo, hi-lo, code[i]) != EXIT_SUCCESS)) return EXIT_FAILURE;
+            if (!streamed[i]) continue;
+            if (code[i] < 3)
+            {
+                if (lzInflateWindow(dctx->win+i, dctx->planes[i], nb, (pos+nb == offset), 1) != MZ_OK) return EXIT_FAILURE;
+                continue;
+            }
+            size = ((nb*packed[i][0])+7)/8; // Windows are whole groups of 8 elements, but for the last one
+            if (lzInflateWindow(dctx->win+i, dctx->planes[i]+nb-size, size, (pos+nb == offset), 1) != MZ_OK) return EXIT_FAILURE;
+            if (lzUnpackBits(dctx->planes[i], dctx->planes[i]+nb-size, 0, nb, packed[i][0]) != EXIT_SUCCESS) return EXIT_FAILURE;
+        }
+        for (i = 0; (i < prec) && (lo < hi); i++) window[i] = planes[i]+(lo-pos);
+        if (lo < hi) lzGatherPlanes(daBuf+((lo-first)*prec), window, hi-lo, prec);
+        for (i = 0; i < prec; i++) if (code[i] == 0) planes[i] = planes[i] + nb; // Plain planes are read in place
     }
+    for (i = 0; (i < prec) && (offset == 0); i++)
+    { // Nothing was delivered, the streams still have to end properly
+        if ((streamed[i]) && (lzInflateWindow(dctx->win+i, NULL, 0, 1, 1) != MZ_OK)) return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int lzUncompressLockstep(lzDContext *dctx, uchar *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, ushort prec)
+{
+    ulong offset;
+    if (inSize < sizeof(ulong)+sizeof(short)) return EXIT_FAILURE;
+    memcpy(&offset, srcBuf, sizeof(ulong));
+    offset = offset/prec;
+    *darSize = offset;
+    return lzUncompressLockstepRange(dctx, daBuf, srcBuf, inSize, prec, 0, offset);
+}
+
+
+/*
+ * Container layout (version 4): the array is cut in chunks of CHUNK_SIZE
+ * bytes of elements, each chunk is split and compressed on its own with the
+ * plane layout of lzCompressFlopnt, so chunks can be processed by any number
+ * of threads. The header describes the array, so readers need nothing out of
+ * band, and the chunk table lets them seek to a chunk and check it before
+ * decoding it.
+ *
+ *   uchar magic[4] ("\x89LZF"), uchar version, uchar type, uchar prec, uchar flags
+ *   ulong nbEle, ulong chunkEle, ulong nbChunks
+ *   short lossy, char code[8], ushort reserved, uint checksum of header and table
+ *   per chunk: ulong offset, ulong size, uint checksum of the chunk
+ *   chunk data
+ *
+ * Version 2 chunks may hold constant (code 3) and packed (code 4) planes,
+ * see lzEncodePlane, version 1 readers would take them for deflate streams.
+ * Version 4 chunks may hold code 5 planes, the few bits kept of a partly
+ * dropped plane packed and possibly deflated, see lzEncodeBits.
+ * The LZ_FLAG_DELTA bit of flags marks chunks holding the XOR of the array
+ * with a reference array truncated to the kept bits (lzCompressDoubleDelta),
+ * decoding needs the same reference.
+ * Integer containers (LZ_TYPE_INT, LZ_TYPE_UINT) hold elements of 1 to 8
+ * bytes, always lossless; their only predictor is LZ_PRED_DELTA and the
+ * LZ_FLAG_ZIGZAG bit marks residuals mapped by lzZigzag, undone first.
+ * The LZ_FLAG_NARROW bit marks a double container whose elements all were
+ * floats (lzFitsFloat): its chunks are those of a float container, with
+ * chunkEle, code and the dropped bits of the planes counted in floats, while
+ * prec and lossy in the header stay those of the doubles; readers widen the
+ * decoded floats in place.
+ * Half containers (LZ_TYPE_HALF, LZ_TYPE_BFLOAT) hold 16-bit floats in two
+ * planes; the container is the same whether the caller gave halves or floats
+ * narrowed on the way in, only the reader decides what to widen them to.
+ * The LZ_FLAG_DICT bit marks deflated planes (codes 1 and 2) whose matches
+ * may reach into the same plane of a preset dictionary (lzSetDictionary),
+ * decoding needs a context with the same dictionary; a wrong one fails the
+ * Adler-32 of the plane.
+ * Version 3 keeps the predictor of the chunks (lzpred.c) in the low bits of
+ * flags, a predictor chunk holds residuals and is undone once decoded.
+ * The Lorenzo predictor (LZ_PRED_LORENZO) needs the whole grid to be undone:
+ * its shape follows the table as ulong nx, ny, nz, covered by the header
+ * checksum, and its chunks hold every bit of the residuals (lossy 0) while
+ * the header keeps the bits dropped before predicting.
+ *
+ * A legacy stream starts with the size of the array in bytes, a multiple of
+ * 4, so its first byte can never be the odd first byte of the magic.
+ */
+
+typedef struct lzChunkJob
+{
+    lzContext **ctx;
+    lzDContext **dctx;
+    lzInfo *info;
+    uchar *daBuf;
+    uchar *srcBuf;
+    uchar **chunkBuf;
+    ulong *chunkSize;
+    ulong nbEle;
+    ulong chunkEle;
+    int *status;
+    ushort prec;
+    short level;
+    short lossy;
+    int predictor;
+    int transform;
+    const ulong *dims;
+    const uchar *refBuf;
+} lzChunkJob;
+
+
+static void lzGetEntry(uchar *srcBuf, ulong i, ulong *offset, ulong *size, unsigned int *checksum)
+{
+    uchar *entry = srcBuf+LZ_HEADER_SIZE+(i*LZ_ENTRY_SIZE);
+    memcpy(offset, entry, sizeof(ulong));
+    memcpy(size, entry+sizeof(ulong), sizeof(ulong));
+    memcpy(checksum, entry+(2*sizeof(ulong)), sizeof(unsigned int));
+}
+
+
+static void lzPutEntry(uchar *dstBuf, ulong i, ulong offset, ulong size)
+{
+    uchar *entry = dstBuf+LZ_HEADER_SIZE+(i*LZ_ENTRY_SIZE);
+    unsigned int checksum = mz_adler32(MZ_ADLER32_INIT, dstBuf+offset, size);
+    memcpy(entry, &offset, sizeof(ulong));
+    memcpy(entry+sizeof(ulong), &size, sizeof(ulong));
+    memcpy(entry+(2*sizeof(ulong)), &checksum, sizeof(unsigned int));
+}
+
+
+static void lzPutHeader(uchar *dstBuf, lzInfo *info)
+{ // The table must be written already, it is covered by the header checksum with the grid
+    unsigned int checksum;
+    ushort reserved = 0;
+    ulong finalSize = 4;
+    memcpy(dstBuf, LZ_MAGIC, 4);
+    dstBuf[finalSize++] = info->version;
+    dstBuf[finalSize++] = info->type;
+    dstBuf[finalSize++] = info->prec;
+    dstBuf[finalSize++] = info->predictor | info->flags;
+    memcpy(dstBuf+finalSize, &(info->nbEle), sizeof(ulong));
+    finalSize = finalSize + sizeof(ulong);
+    memcpy(dstBuf+finalSize, &(info->chunkEle), sizeof(ulong));
+    finalSize = finalSize + sizeof(ulong);
+    memcpy(dstBuf+finalSize, &(info->nbChunks), sizeof(ulong));
+    finalSize = finalSize + sizeof(ulong);
+    memcpy(dstBuf+finalSize, &(info->lossy), sizeof(short));
+    finalSize = finalSize + sizeof(short);
+    memcpy(dstBuf+finalSize, info->code, 8);
+    finalSize = finalSize + 8;
+    memcpy(dstBuf+finalSize, &reserved, sizeof(ushort));
+    finalSize = finalSize + sizeof(ushort);
+    if (info->predictor == LZ_PRED_LORENZO) memcpy(dstBuf+info->dataOffset-LZ_GRID_SIZE, info->dims, LZ_GRID_SIZE);
+    checksum = mz_adler32(MZ_ADLER32_INIT, dstBuf, finalSize);
+    checksum = mz_adler32(checksum, dstBuf+LZ_HEADER_SIZE, info->dataOffset-LZ_HEADER_SIZE);
+    memcpy(dstBuf+finalSize, &checksum, sizeof(unsigned int));
+}
+
+
+int lzIsContainer(uchar *srcBuf, ulong inSize)
+{
+    return (inSize >= 4) && (memcmp(srcBuf, LZ_MAGIC, 4) == 0);
+}
+
+
+int lzGetInfo(lzInfo *info, uchar *srcBuf, ulong inSize)
+{ // Header and chunk table are validated, the chunks are checked only when decoded
+    ulong i, offset, size, finalSize = 4;
+    unsigned int checksum, sum;
+    memset(info, 0, sizeof(lzInfo));
+    if (!lzIsContainer(srcBuf, inSize))
+    { // Legacy stream, only the size in bytes is known
+        if (inSize < sizeof(ulong)+sizeof(short)) return EXIT_FAILURE;
+        memcpy(&(info->nbBytes), srcBuf, sizeof(ulong));
+        memcpy(&(info->lossy), srcBuf+sizeof(ulong), sizeof(short));
+        return EXIT_SUCCESS;
+    }
+    if (inSize < LZ_HEADER_SIZE) return EXIT_FAILURE;
+    info->version = srcBuf[finalSize++];
+    info->type = srcBuf[finalSize++];
+    info->prec = srcBuf[finalSize++];
+    info->predictor = srcBuf[finalSize] & LZ_FLAG_PRED;
+    info->flags = srcBuf[finalSize++] & ~LZ_FLAG_PRED;
+    memcpy(&(info->nbEle), srcBuf+finalSize, sizeof(ulong));
+    finalSize = finalSize + sizeof(ulong);
+    memcpy(&(info->chunkEle), srcBuf+finalSize, sizeof(ulong));
+    finalSize = finalSize + sizeof(ulong);
+    memcpy(&(info->nbChunks), srcBuf+finalSize, sizeof(ulong));
+    finalSize = finalSize + sizeof(ulong);
+    memcpy(&(info->lossy), srcBuf+finalSize, sizeof(short));
+    finalSize = finalSize + sizeof(short);
+    memcpy(info->code, srcBuf+finalSize, 8);
+    finalSize = finalSize + 8 + sizeof(ushort);
+    memcpy(&checksum, srcBuf+finalSize, sizeof(unsigned int));
+    if ((info->version < 1) || (info->version > LZ_VERSION) || (info->prec == 0) || (info->prec > 8)) return EXIT_FAILURE;
+    if ((info->flags & ~(LZ_FLAG_DELTA | LZ_FLAG_DICT | LZ_FLAG_ZIGZAG | LZ_FLAG_NARROW)) || (info->predictor > LZ_PRED_LORENZO)) return EXIT_FAILURE;
+    if ((info->flags & LZ_FLAG_NARROW) && ((info->type != LZ_TYPE_DOUBLE) || (info->prec != 8) || (info->flags & (LZ_FLAG_DELTA | LZ_FLAG_DICT)) || (info->predictor == LZ_PRED_LORENZO))) return EXIT_FAILURE;
+    if ((info->flags & LZ_FLAG_DELTA) && (info->predictor != LZ_PRED_NONE)) return EXIT_FAILURE;
+    if ((info->nbEle > 0) && (info->chunkEle == 0)) return EXIT_FAILURE;
+    if ((info->nbEle > 0) && (info->nbChunks != (info->nbEle+info->chunkEle-1)/info->chunkEle)) return EXIT_FAILURE;
+    if ((info->nbEle == 0) && (info->nbChunks != 0)) return EXIT_FAILURE;
+    if (info->nbChunks > (inSize-LZ_HEADER_SIZE)/LZ_ENTRY_SIZE) return EXIT_FAILURE;
+    info->nbBytes = info->nbEle*info->prec;
+    info->dataOffset = LZ_HEADER_SIZE+(info->nbChunks*LZ_ENTRY_SIZE);
+    info->dims[0] = info->nbEle;
+    info->dims[1] = 1;
+    info->dims[2] = 1;
+    if (info->predictor == LZ_PRED_LORENZO)
+    { // The grid must hold exactly the elements
+        if (info->dataOffset+LZ_GRID_SIZE > inSize) return EXIT_FAILURE;
+        memcpy(info->dims, srcBuf+info->dataOffset, LZ_GRID_SIZE);
+        info->dataOffset = info->dataOffset + LZ_GRID_SIZE;
+        if ((info->dims[0] == 0) || (info->dims[1] == 0) || (info->dims[2] == 0)) return EXIT_FAILURE;
+        if ((info->dims[1] > info->nbEle/info->dims[0]) || (info->dims[2] > info->nbEle/(info->dims[0]*info->dims[1]))) return EXIT_FAILURE;
+        if (info->dims[0]*info->dims[1]*info->dims[2] != info->nbEle) return EXIT_FAILURE;
+    }
+    sum = mz_adler32(MZ_ADLER32_INIT, srcBuf, finalSize);
+    sum = mz_adler32(sum, srcBuf+LZ_HEADER_SIZE, info->dataOffset-LZ_HEADER_SIZE);
+    if (sum != checksum) return EXIT_FAILURE;
+    for (i = 0; i < info->nbChunks; i++)
+    {
+        lzGetEntry(srcBuf, i, &offset, &size, &checksum);
+        if ((offset < info->dataOffset) || (offset > inSize) || (size > inSize-offset)) return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+static void lzXorReference(uchar *buf, const uchar *refBuf, ulong n, ushort prec, short lossy)
+{ // The reference is truncated to the kept bits, so the decoded previous array gives the same result as its source
+    ulong i, w, r, keep = (lossy >= 64) ? 0 : ~((1UL << lossy)-1);
+    if (prec == 4) keep = (lossy >= 32) ? 0 : (keep & 0xFFFFFFFFUL) | (keep << 32);
+    for (i = 0; i+8 <= n*prec; i = i+8)
+    {
+        memcpy(&w, buf+i, 8);
+        memcpy(&r, refBuf+i, 8);
+        w = w ^ (r & keep);
+        memcpy(buf+i, &w, 8);
+    }
+    if (i < n*prec)
+    { // Odd number of floats
+        w = 0;
+        r = 0;
+        memcpy(&w, buf+i, (n*prec)-i);
+        memcpy(&r, refBuf+i, (n*prec)-i);
+        w = w ^ (r & keep);
+        memcpy(buf+i, &w, (n*prec)-i);
+    }
+}
+
+
+static int lzSplitDelta(uchar **planes, const uchar *src, const uchar *refBuf, ulong n, ushort prec, short lossy, int round)
+{ // As lzSplitQuantized, each block is XORed with the reference before it is split
+    ulong block[QUANT_SIZE/sizeof(ulong)], i, nb, step = QUANT_SIZE/prec;
+    uchar *dst[8];
+    int j;
+    for (i = 0; i < n; i = i+nb)
+    {
+        nb = (n-i < step) ? n-i : step;
+        if (lzQuantize((uchar *)block, src+(i*prec), nb, prec, lossy, round) != EXIT_SUCCESS) return EXIT_FAILURE;
+        lzXorReference((uchar *)block, refBuf+(i*prec), nb, prec, lossy);
+        for (j = 0; j < prec; j++) dst[j] = planes[j]+i;
+        lzSplitPlanes(dst, (uchar *)block, nb, prec);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int lzSplitChunk(lzContext *ctx, uchar *daBuf, const uchar *refBuf, ulong first, ulong nbEle, ushort prec, int predictor, int transform, short lossy, const ulong *dims)
+{ // Planes of the chunk of nbEle elements at first, taken from the residuals when a predictor, zigzag or a reference is set
+    const uchar *src = daBuf+(first*prec);
+    uchar *buf;
+    int res, narrow = transform & (LZ_HALF_FROM_FLOAT | LZ_BFLOAT_FROM_FLOAT | LZ_FLOAT_FROM_DOUBLE), round = (ctx->quantizer == LZ_QUANT_ROUND);
+    if (refBuf != NULL) return lzSplitDelta(ctx->planes, src, refBuf+(first*prec), nbEle, prec, lossy, round);
+    if ((narrow) && (predictor == LZ_PRED_NONE)) return lzSplitNarrowed(ctx->planes, daBuf, first, nbEle, prec, transform, lossy, round);
+    if ((predictor != LZ_PRED_NONE) || (transform & LZ_INT_ZIGZAG))
+    {
+        if (nbEle*prec > ctx->resSize)
+        {
+            buf = realloc(ctx->resBuf, nbEle*prec);
+            if (buf == NULL) return EXIT_FAILURE;
+            ctx->resBuf = buf;
+            ctx->resSize = nbEle*prec;
+        }
+        if (narrow)
+        { // The caller's elements are wider, they are narrowed first and predicted in place
+            lzNarrow(ctx->resBuf, daBuf, first, nbEle, transform);
+            src = ctx->resBuf;
+        }
+        if (predictor == LZ_PRED_LORENZO) res = lzLorenzo(ctx->resBuf, daBuf, dims, first, nbEle, prec, lossy, round);
+        else if (predictor == LZ_PRED_NONE)
+        { // Zigzag alone, integer arrays are never quantized
+            memcpy(ctx->resBuf, src, nbEle*prec);
+            res = EXIT_SUCCESS;
+        } else if (round)
+        { // Rounded first, the predictor then runs in place and its own masking changes nothing
+            res = lzQuantize(ctx->resBuf, src, nbEle, prec, lossy, round);
+            if (res == EXIT_SUCCESS) res = lzPredict(ctx->resBuf, ctx->resBuf, nbEle, prec, predictor, lossy);
+        } else {
+            res = lzPredict(ctx->resBuf, src, nbEle, prec, predictor, lossy);
+        }
+        if ((res == EXIT_SUCCESS) && (transform & LZ_INT_ZIGZAG)) res = lzZigzag(ctx->resBuf, nbEle, prec);
+        if (res != EXIT_SUCCESS) return EXIT_FAILURE;
+        return lzSplitPlanes(ctx->planes, ctx->resBuf, nbEle, prec);
+    }
+    return lzSplitQuantized(ctx->planes, src, nbEle, prec, lossy, round);
+}
+
+
+void lzCompressChunkTask(void *arg, int i, int worker)
+{
+    lzChunkJob *job = arg;
+    lzContext *ctx = job->ctx[worker];
+    ulong first = i*job->chunkEle, nbEle = job->chunkEle;
+    short lossy = (job->predictor == LZ_PRED_LORENZO) ? 0 : job->lossy;
+    if (first+nbEle > job->nbEle) nbEle = job->nbEle-first;
+    job->chunkSize[i] = lzCompressFlopntBound(nbEle, job->prec, lossy);
+    job->chunkBuf[i] = malloc(job->chunkSize[i]);
+    if (job->chunkBuf[i] == NULL)
+    {
+        job->status[i] = EXIT_FAILURE;
+        return;
+    }
+    job->status[i] = lzSplitChunk(ctx, job->daBuf, job->refBuf, first, nbEle, job->prec, job->predictor, job->transform, job->lossy, job->dims);
+    if (job->status[i] == EXIT_SUCCESS) job->status[i] = lzCompressFlopntCtx(ctx, job->chunkBuf[i], job->chunkSize+i, ctx->planes, nbEle, job->prec, job->level, lossy);
+}
+
+
+int lzUncompressLegacyMT(uchar *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, ushort size, int nbThreads)
+{ // Streams written before the container, the planes are inflated concurrently
+    uchar *tmpBuf[8];
+    ulong i, offset;
+    int res = EXIT_SUCCESS;
+
+    memcpy(&offset, srcBuf, sizeof(ulong));
+    offset = offset/size;
+    *darSize = offset;
+    for (i = 0; i < size; i++) if ((tmpBuf[i] = malloc(offset)) == NULL) res = EXIT_FAILURE;
+    if (res == EXIT_SUCCESS) res = lzUncompressFlopntMT(tmpBuf, offset, srcBuf, inSize, size, nbThreads);
+    if (res == EXIT_SUCCESS) lzGatherPlanes(daBuf, tmpBuf, offset, size);
     for (i = 0; i < size; i++) free(tmpBuf[i]);
+    return res;
+}
+
+
+int lzUncompressChunk(lzDContext *dctx, uchar *daBuf, const uchar *refBuf, uchar *srcBuf, lzInfo *info, ulong i, int nbThreads)
+{ // Check the chunk against its checksum and decode it in place, planes in parallel if threads are given
+    ulong offset, size, nbEle, first = i*info->chunkEle;
+    unsigned int checksum;
+    int res;
+    lzGetEntry(srcBuf, i, &offset, &size, &checksum);
+    if (mz_adler32(MZ_ADLER32_INIT, srcBuf+offset, size) != checksum) return EXIT_FAILURE;
+    if (nbThreads > 1) res = lzUncompressLegacyMT(daBuf+(first*info->prec), &nbEle, srcBuf+offset, size, info->prec, nbThreads);
+    else res = lzUncompressLockstep(dctx, daBuf+(first*info->prec), &nbEle, srcBuf+offset, size, info->prec);
+    if (res != EXIT_SUCCESS) return EXIT_FAILURE;
+    if (first+nbEle != ((i+1 == info->nbChunks) ? info->nbEle : first+info->chunkEle)) return EXIT_FAILURE;
+    if (info->flags & LZ_FLAG_ZIGZAG) lzUnzigzag(daBuf+(first*info->prec), nbEle, info->prec);
+    if (lzUnpredict(daBuf+(first*info->prec), nbEle, info->prec, info->predictor) != EXIT_SUCCESS) return EXIT_FAILURE;
+    if (refBuf != NULL) lzXorReference(daBuf+(first*info->prec), refBuf+(first*info->prec), nbEle, info->prec, info->lossy);
+    return EXIT_SUCCESS;
+}
+
+
+void lzUncompressChunkTask(void *arg, int i, int worker)
+{
+    lzChunkJob *job = arg;
+    job->status[i] = lzUncompressChunk(job->dctx[worker], job->daBuf, job->refBuf, job->srcBuf, job->info, i, 1);
+}
+
+
+ulong lzCompressChunksBound(ulong daSize, ushort prec, short lossy, int predictor)
+{ // Header, chunk table, grid, full chunks and the tail chunk
+    ulong chunkEle = CHUNK_SIZE/prec, nbChunks = (daSize+chunkEle-1)/chunkEle;
+    ulong bound = LZ_HEADER_SIZE+(nbChunks*LZ_ENTRY_SIZE);
+    if (predictor == LZ_PRED_LORENZO)
+    { // Every bit of the residuals is compressed
+        bound = bound + LZ_GRID_SIZE;
+        lossy = 0;
+    }
+    bound = bound + ((daSize/chunkEle)*lzCompressFlopntBound(chunkEle, prec, lossy));
+    if (daSize%chunkEle != 0) bound = bound + lzCompressFlopntBound(daSize%chunkEle, prec, lossy);
+    return bound;
+}
+
+
+int lzCompressChunks(
+        lzContext *ctx,
+        uchar *dstBuf,
+        ulong *outSize,
+        uchar *daBuf,
+        ulong daSize,
+        uchar type,
+        ushort prec,
+        short level,
+        short lossy,
+        const ulong *dims,
+        const uchar *refBuf,
+        int transform,
+        int nbThreads )
+{ // A caller context is used for the serial path, workers get their own, a grid selects the Lorenzo predictor, a reference the delta and transform the LZ_INT_* steps of integers
+    lzChunkJob job;
+    lzInfo info;
+    ulong i, size, first, chunkSize, finalSize, capacity = *outSize;
+    int code[8], planeThreads, res = EXIT_SUCCESS;
+    short chunkLossy = lossy;
+    int integer = (type == LZ_TYPE_INT) || (type == LZ_TYPE_UINT);
+    int half = (type == LZ_TYPE_HALF) || (type == LZ_TYPE_BFLOAT);
+    int narrow = (type == LZ_TYPE_HALF) ? LZ_HALF_FROM_FLOAT : LZ_BFLOAT_FROM_FLOAT;
+
+    if ((prec < 1) || (prec > 8)) return EXIT_FAILURE;
+    if ((level < 1) || (level > MAX_LEVEL)) return EXIT_FAILURE;
+    if ((lossy < 0) || (lossy > (prec*8))) return EXIT_FAILURE;
+    if ((dims != NULL) && (refBuf != NULL)) return EXIT_FAILURE;
+    if ((!integer) && (!half) && ((transform != 0) || ((prec != 4) && (prec != 8)))) return EXIT_FAILURE;
+    if ((half) && ((prec != 2) || (dims != NULL) || (refBuf != NULL) || ((transform != 0) && (transform != narrow)))) return EXIT_FAILURE;
+    if ((integer) && ((lossy != 0) || (dims != NULL) || (refBuf != NULL) || (transform & ~(LZ_INT_DELTA | LZ_INT_ZIGZAG)))) return EXIT_FAILURE;
+    if ((ctx != NULL) && (ctx->dictSize > 0) && (ctx->dictPrec != prec)) return EXIT_FAILURE;
+    if ((ctx != NULL) && (ctx->dictSize > 0)) nbThreads = 1; // Only the caller context has the dictionary
+    if (nbThreads < 1) nbThreads = 1;
+    if (nbThreads > MAX_THREADS) nbThreads = MAX_THREADS;
+    planeThreads = nbThreads;
+    memset(&info, 0, sizeof(lzInfo));
+    info.version = LZ_VERSION;
+    info.type = type;
+    info.prec = prec;
+    info.lossy = lossy;
+    if ((ctx != NULL) && (ctx->narrowing == LZ_NARROW_FLOAT) && (type == LZ_TYPE_DOUBLE) && (dims == NULL) && (ctx->predictor != LZ_PRED_LORENZO) && (refBuf == NULL) && (ctx->dictSize == 0) && (lossy <= 52) && (lzFitsFloat((const double *)daBuf, daSize)))
+    { // Doubles that all came from floats go through the float planes, the float mantissa ends 29 bits above the double one
+        transform = LZ_FLOAT_FROM_DOUBLE;
+        prec = sizeof(float);
+        lossy = (lossy > 29) ? lossy-29 : 0;
+        chunkLossy = lossy;
+    }
+    info.predictor = (dims != NULL) ? LZ_PRED_LORENZO : ((refBuf != NULL) ? LZ_PRED_NONE : ((ctx != NULL) ? ctx->predictor : LZ_PRED_NONE));
+    info.flags = (refBuf != NULL) ? LZ_FLAG_DELTA : 0;
+    if (integer) info.predictor = (transform & LZ_INT_DELTA) ? LZ_PRED_DELTA : LZ_PRED_NONE;
+    if ((half) && (info.predictor != LZ_PRED_LAST) && (info.predictor != LZ_PRED_DELTA) && (info.predictor != LZ_PRED_STRIDE2)) info.predictor = LZ_PRED_NONE;
+    if (transform & LZ_INT_ZIGZAG) info.flags = info.flags | LZ_FLAG_ZIGZAG;
+    if ((ctx != NULL) && (ctx->dictSize > 0)) info.flags = info.flags | LZ_FLAG_DICT;
+    if (transform & LZ_FLOAT_FROM_DOUBLE) info.flags = info.flags | LZ_FLAG_NARROW;
+    info.nbEle = daSize;
+    info.chunkEle = CHUNK_SIZE/prec;
+    info.nbChunks = (daSize+info.chunkEle-1)/info.chunkEle;
+    info.dataOffset = LZ_HEADER_SIZE+(info.nbChunks*LZ_ENTRY_SIZE);
+    info.dims[0] = daSize;
+    info.dims[1] = 1;
+    info.dims[2] = 1;
+    if (info.predictor == LZ_PRED_LORENZO)
+    { // A flat array is a grid of a single row
+        if (dims != NULL) memcpy(info.dims, dims, LZ_GRID_SIZE);
+        info.dataOffset = info.dataOffset + LZ_GRID_SIZE;
+        chunkLossy = 0;
+    }
+    getCode(code, prec, chunkLossy);
+    for (i = 0; i < prec; i++) info.code[i] = code[i];
+    if (info.dataOffset > capacity) return EXIT_FAILURE;
+    finalSize = info.dataOffset;
+    if ((ulong)nbThreads > info.nbChunks) nbThreads = (info.nbChunks > 0) ? info.nbChunks : 1;
+    if (nbThreads == 1)
+    { // Every chunk is compressed at its final position, a single chunk gets the threads on its planes
+        lzContext *own = (ctx == NULL) ? lzCreateContext() : NULL;
+        if (ctx == NULL) ctx = own;
+        if ((ctx == NULL) || (lzReserveContext(ctx, info.chunkEle, prec) != EXIT_SUCCESS)) res = EXIT_FAILURE;
+        for (i = 0; (i < info.nbChunks) && (res == EXIT_SUCCESS); i++)
+        {
+            first = i*info.chunkEle;
+            size = (first+info.chunkEle > daSize) ? daSize-first : info.chunkEle;
+            res = lzSplitChunk(ctx, daBuf, refBuf, first, size, prec, info.predictor, transform, lossy, info.dims);
+            chunkSize = capacity-finalSize;
+            if (res != EXIT_SUCCESS) break;
+            if (planeThreads > 1) res = lzCompressFlopntMT(ctx, dstBuf+finalSize, &chunkSize, ctx->planes, size, prec, level, chunkLossy, planeThreads);
+            else res = lzCompressFlopntCtx(ctx, dstBuf+finalSize, &chunkSize, ctx->planes, size, prec, level, chunkLossy);
+            if (res == EXIT_SUCCESS) lzPutEntry(dstBuf, i, finalSize, chunkSize);
+            finalSize = finalSize + chunkSize;
+        }
+        lzDestroyContext(own);
+    } else {
+        memset(&job, 0, sizeof(lzChunkJob));
+        job.daBuf = daBuf;
+        job.nbEle = daSize;
+        job.chunkEle = info.chunkEle;
+        job.prec = prec;
+        job.level = level;
+        job.lossy = lossy;
+        job.predictor = info.predictor;
+        job.transform = transform;
+        job.dims = info.dims;
+        job.refBuf = refBuf;
+        job.ctx = calloc(nbThreads, sizeof(lzContext *));
+        job.chunkBuf = calloc(info.nbChunks, sizeof(uchar *));
+        job.chunkSize = calloc(info.nbChunks, sizeof(ulong));
+        job.status = calloc(info.nbChunks, sizeof(int));
+        if ((job.ctx == NULL) || (job.chunkBuf == NULL) || (job.chunkSize == NULL) || (job.status == NULL)) res = EXIT_FAILURE;
+        for (i = 0; (i < (ulong)nbThreads) && (res == EXIT_SUCCESS); i++)
+        { // One context per worker, reused for all the chunks it runs
+            job.ctx[i] = lzCreateContext();
+            if ((job.ctx[i] == NULL) || (lzReserveContext(job.ctx[i], job.chunkEle, prec) != EXIT_SUCCESS)) res = EXIT_FAILURE;
+            else if (ctx != NULL) lzCopySettings(job.ctx[i], ctx);
+        }
+        if (res == EXIT_SUCCESS) lzParallelFor(nbThreads, info.nbChunks, lzCompressChunkTask, &job);
+        for (i = 0; (i < info.nbChunks) && (res == EXIT_SUCCESS); i++)
+        {
+            if ((job.status[i] != EXIT_SUCCESS) || (job.chunkSize[i] > capacity-finalSize)) res = EXIT_FAILURE;
+            if (res != EXIT_SUCCESS) break;
+            memcpy(dstBuf+finalSize, job.chunkBuf[i], job.chunkSize[i]);
+            lzPutEntry(dstBuf, i, finalSize, job.chunkSize[i]);
+            finalSize = finalSize + job.chunkSize[i];
+        }
+        for (i = 0; (i < info.nbChunks) && (job.chunkBuf != NULL); i++) free(job.chunkBuf[i]);
+        for (i = 0; (i < (ulong)nbThreads) && (job.ctx != NULL); i++) lzDestroyContext(job.ctx[i]);
+        free(job.ctx);
+        free(job.chunkBuf);
+        free(job.chunkSize);
+        free(job.status);
+    }
+    if (res != EXIT_SUCCESS) return EXIT_FAILURE;
+    lzPutHeader(dstBuf, &info);
+    *outSize = finalSize;
+    return EXIT_SUCCESS;
+}
+
+
+int lzUncompressChunks(lzDContext *dctx, uchar *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, uchar type, const uchar *refBuf, int nbThreads)
+{ // A caller context is used for the serial path, workers get their own, a delta container needs its reference
+    lzChunkJob job;
+    lzInfo info;
+    ulong i;
+    int planeThreads, res = EXIT_SUCCESS;
+
+    if (lzGetInfo(&info, srcBuf, inSize) != EXIT_SUCCESS) return EXIT_FAILURE;
+    if ((info.version == 0) || (info.type != type)) return EXIT_FAILURE;
+    if (((info.flags & LZ_FLAG_DELTA) != 0) != (refBuf != NULL)) return EXIT_FAILURE;
+    if ((info.flags & LZ_FLAG_DICT) && ((dctx == NULL) || (dctx->dictSize == 0) || (dctx->dictPrec != info.prec))) return EXIT_FAILURE;
+    if (info.flags & LZ_FLAG_DICT) nbThreads = 1; // Planes are primed in the lockstep windows of dctx
+    if (info.flags & LZ_FLAG_NARROW) info.prec = sizeof(float); // Chunks hold floats, decoded in the first half of daBuf
+    *darSize = info.nbEle;
+    if (nbThreads < 1) nbThreads = 1;
+    if (nbThreads > MAX_THREADS) nbThreads = MAX_THREADS;
+    planeThreads = nbThreads;
+    if ((ulong)nbThreads > info.nbChunks) nbThreads = (info.nbChunks > 0) ? info.nbChunks : 1;
+    if (nbThreads == 1)
+    { // A single chunk gets the threads on its planes
+        lzDContext *own = (dctx == NULL) ? lzCreateDContext() : NULL;
+        if (dctx == NULL) dctx = own;
+        if (dctx == NULL) return EXIT_FAILURE;
+        for (i = 0; (i < info.nbChunks) && (res == EXIT_SUCCESS); i++) res = lzUncompressChunk(dctx, daBuf, refBuf, srcBuf, &info, i, planeThreads);
+        lzDestroyDContext(own);
+    } else {
+        memset(&job, 0, sizeof(lzChunkJob));
+        job.daBuf = daBuf;
+        job.srcBuf = srcBuf;
+        job.refBuf = refBuf;
+        job.info = &info;
+        job.dctx = calloc(nbThreads, sizeof(lzDContext *));
+        job.status = calloc(info.nbChunks, sizeof(int));
+        if ((job.dctx == NULL) || (job.status == NULL)) res = EXIT_FAILURE;
+        for (i = 0; (i < (ulong)nbThreads) && (res == EXIT_SUCCESS); i++) if ((job.dctx[i] = lzCreateDContext()) == NULL) res = EXIT_FAILURE;
+        if (res == EXIT_SUCCESS) lzParallelFor(nbThreads, info.nbChunks, lzUncompressChunkTask, &job);
+        for (i = 0; (i < info.nbChunks) && (res == EXIT_SUCCESS); i++) if (job.status[i] != EXIT_SUCCESS) res = EXIT_FAILURE;
+        for (i = 0; (i < (ulong)nbThreads) && (job.dctx != NULL); i++) lzDestroyDContext(job.dctx[i]);
+        free(job.dctx);
+        free(job.status);
+    }
+    if ((res == EXIT_SUCCESS) && (info.predictor == LZ_PRED_LORENZO)) res = lzUnlorenzo(daBuf, info.dims, info.prec, info.lossy);
+    if ((res == EXIT_SUCCESS) && (info.flags & LZ_FLAG_NARROW)) res = lzFloatToDouble((double *)daBuf, (const float *)daBuf, info.nbEle);
+    return res;
+}
+
+
+int lzUncompressRange(uchar *daBuf, uchar *srcBuf, ulong inSize, uchar type, ushort prec, ulong first, ulong count)
+{ // Only the chunks covering the range are checked and inflated, each one up to the last element needed
+    lzDContext *dctx;
+    lzInfo info;
+    uchar *buf, *resBuf = NULL;
+    ulong i, lo, hi, offset, size, nbEle, chunkFirst;
+    unsigned int checksum;
+    int res = EXIT_SUCCESS;
+
+    if (lzGetInfo(&info, srcBuf, inSize) != EXIT_SUCCESS) return EXIT_FAILURE;
+    if ((info.version != 0) && (info.type != type)) return EXIT_FAILURE;
+    if (info.predictor == LZ_PRED_LORENZO) return EXIT_FAILURE; // The grid is only undone as a whole
+    if (info.flags & (LZ_FLAG_DELTA | LZ_FLAG_DICT)) return EXIT_FAILURE; // No reference nor dictionary is given
+    if (info.flags & LZ_FLAG_NARROW) prec = sizeof(float); // Floats in the first half of daBuf, widened at the end
+    if (info.version == 0)
+    { // A legacy stream is a single block
+        info.nbEle = info.nbBytes/prec;
+        info.chunkEle = info.nbEle;
+        info.nbChunks = 1;
+    }
+    if ((first > info.nbEle) || (count > info.nbEle-first)) return EXIT_FAILURE;
+    if (count == 0) return EXIT_SUCCESS;
+    dctx = lzCreateDContext();
+    if (dctx == NULL) return EXIT_FAILURE;
+    for (i = first/info.chunkEle; (i <= (first+count-1)/info.chunkEle) && (res == EXIT_SUCCESS); i++)
+    {
+        chunkFirst = i*info.chunkEle;
+        nbEle = (i+1 == info.nbChunks) ? info.nbEle-chunkFirst : info.chunkEle;
+        lo = (first > chunkFirst) ? first-chunkFirst : 0;
+        hi = (first+count < chunkFirst+nbEle) ? first+count-chunkFirst : nbEle;
+        if (info.version == 0)
+        {
+            offset = 0;
+            size = inSize;
+        } else {
+            lzGetEntry(srcBuf, i, &offset, &size, &checksum);
+            if (mz_adler32(MZ_ADLER32_INIT, srcBuf+offset, size) != checksum) res = EXIT_FAILURE;
+        }
+        if ((res == EXIT_SUCCESS) && ((info.predictor == LZ_PRED_NONE) || (lo == 0)))
+        { // Residuals of a chunk are undone from its start, which is where this range starts
+            res = lzUncompressLockstepRange(dctx, daBuf+((chunkFirst+lo-first)*prec), srcBuf+offset, size, prec, lo, hi-lo);
+            if ((res == EXIT_SUCCESS) && (info.flags & LZ_FLAG_ZIGZAG)) res = lzUnzigzag(daBuf+((chunkFirst+lo-first)*prec), hi-lo, prec);
+            if (res == EXIT_SUCCESS) res = lzUnpredict(daBuf+((chunkFirst+lo-first)*prec), hi-lo, prec, info.predictor);
+        } else if (res == EXIT_SUCCESS) { // The chunk is decoded up to hi and only the range is kept
+            buf = realloc(resBuf, hi*prec);
+            if (buf == NULL) res = EXIT_FAILURE;
+            else resBuf = buf;
+            if (res == EXIT_SUCCESS) res = lzUncompressLockstepRange(dctx, resBuf, srcBuf+offset, size, prec, 0, hi);
+            if ((res == EXIT_SUCCESS) && (info.flags & LZ_FLAG_ZIGZAG)) res = lzUnzigzag(resBuf, hi, prec);
+            if (res == EXIT_SUCCESS) res = lzUnpredict(resBuf, hi, prec, info.predictor);
+            if (res == EXIT_SUCCESS) memcpy(daBuf+((chunkFirst+lo-first)*prec), resBuf+(lo*prec), (hi-lo)*prec);
+        }
+    }
+    free(resBuf);
+    lzDestroyDContext(dctx);
+    if ((res == EXIT_SUCCESS) && (info.flags & LZ_FLAG_NARROW)) res = lzFloatToDouble((double *)daBuf, (const float *)daBuf, count);
+    return res;
+}
+
+
+ulong lzCompressFloat3DBound(ulong nx, ulong ny, ulong nz, short protect)
+{
+    return lzCompressChunksBound(nx*ny*nz, sizeof(float), (sizeof(float)*8)-protect, LZ_PRED_LORENZO);
+}
+
+
+ulong lzCompressDouble3DBound(ulong nx, ulong ny, ulong nz, short protect)
+{
+    return lzCompressChunksBound(nx*ny*nz, sizeof(double), (sizeof(double)*8)-protect, LZ_PRED_LORENZO);
+}
+
+
+int lzCompressGrid(uchar *dstBuf, ulong *outSize, uchar *daBuf, ulong nx, ulong ny, ulong nz, uchar type, ushort prec, short level, short protect)
+{ // A grid of nx*ny*nz elements, x fastest, compressed with the Lorenzo predictor
+    ulong dims[3];
+    if ((nx == 0) || (ny == 0) || (nz == 0)) return EXIT_FAILURE;
+    if ((ny > ~0UL/prec/nx) || (nz > ~0UL/prec/(nx*ny))) return EXIT_FAILURE;
+    dims[0] = nx;
+    dims[1] = ny;
+    dims[2] = nz;
+    return lzCompressChunks(NULL, dstBuf, outSize, daBuf, nx*ny*nz, type, prec, level, (prec*8)-protect, dims, NULL, 0, 1);
+}
+
+
+int lzUncompressGrid(uchar *daBuf, ulong *nx, ulong *ny, ulong *nz, uchar *srcBuf, ulong inSize, uchar type)
+{ // Any container, a flat array comes back as a single row
+    lzInfo info;
+    ulong nbEle;
+    if (lzGetInfo(&info, srcBuf, inSize) != EXIT_SUCCESS) return EXIT_FAILURE;
+    if ((info.version == 0) || (info.type != type)) return EXIT_FAILURE;
+    if (lzUncompressChunks(NULL, daBuf, &nbEle, srcBuf, inSize, type, NULL, 1) != EXIT_SUCCESS) return EXIT_FAILURE;
+    *nx = info.dims[0];
+    *ny = info.dims[1];
+    *nz = info.dims[2];
     return EXIT_SUCCESS;
 }
 
 
+int lzCompressFloat3D(uchar *dstBuf, ulong *outSize, float *darBuf, ulong nx, ulong ny, ulong nz, short level, short protect)
+{
+    return lzCompressGrid(dstBuf, outSize, (uchar *)darBuf, nx, ny, nz, LZ_TYPE_FLOAT, sizeof(float), level, protect);
+}
+
+
+int lzUncompressFloat3D(float *darBuf, ulong *nx, ulong *ny, ulong *nz, uchar *srcBuf, ulong inSize)
+{
+    return lzUncompressGrid((uchar *)darBuf, nx, ny, nz, srcBuf, inSize, LZ_TYPE_FLOAT);
+}
+
+
+int lzCompressDouble3D(uchar *dstBuf, ulong *outSize, double *daBuf, ulong nx, ulong ny, ulong nz, short level, short protect)
+{
+    return lzCompressGrid(dstBuf, outSize, (uchar *)daBuf, nx, ny, nz, LZ_TYPE_DOUBLE, sizeof(double), level, protect);
+}
+
+
+int lzUncompressDouble3D(double *daBuf, ulong *nx, ulong *ny, ulong *nz, uchar *srcBuf, ulong inSize)
+{
+    return lzUncompressGrid((uchar *)daBuf, nx, ny, nz, srcBuf, inSize, LZ_TYPE_DOUBLE);
+}
+
+
+int lzCompressFloatDelta(uchar *dstBuf, ulong *outSize, float *darBuf, const float *refBuf, ulong daSize, short level, short protect, int nbThreads)
+{ // refBuf is the previous snapshot, its source or its decoded copy, the elements are truncated and both give the same bits
+    short lossy = (sizeof(float)*8)-protect;
+    if (refBuf == NULL) return EXIT_FAILURE;
+    return lzCompressChunks(NULL, dstBuf, outSize, (uchar *)darBuf, daSize, LZ_TYPE_FLOAT, sizeof(float), level, lossy, NULL, (const uchar *)refBuf, 0, nbThreads);
+}
+
+
+int lzUncompressFloatDelta(float *darBuf, ulong *darSize, const float *refBuf, uchar *srcBuf, ulong inSize, int nbThreads)
+{ // refBuf must keep the same bits as the reference given to lzCompressFloatDelta
+    if (refBuf == NULL) return EXIT_FAILURE;
+    return lzUncompressChunks(NULL, (uchar *)darBuf, darSize, srcBuf, inSize, LZ_TYPE_FLOAT, (const uchar *)refBuf, nbThreads);
+}
+
+
+int lzCompressDoubleDelta(uchar *dstBuf, ulong *outSize, double *daBuf, const double *refBuf, ulong daSize, short level, short protect, int nbThreads)
+{
+    short lossy = (sizeof(double)*8)-protect;
+    if (refBuf == NULL) return EXIT_FAILURE;
+    return lzCompressChunks(NULL, dstBuf, outSize, (uchar *)daBuf, daSize, LZ_TYPE_DOUBLE, sizeof(double), level, lossy, NULL, (const uchar *)refBuf, 0, nbThreads);
+}
+
+
+int lzUncompressDoubleDelta(double *daBuf, ulong *darSize, const double *refBuf, uchar *srcBuf, ulong inSize, int nbThreads)
+{
+    if (refBuf == NULL) return EXIT_FAILURE;
+    return lzUncompressChunks(NULL, (uchar *)daBuf, darSize, srcBuf, inSize, LZ_TYPE_DOUBLE, (const uchar *)refBuf, nbThreads);
+}
+
+
+ulong lzCompressIntBound(ulong daSize, ushort prec)
+{ // Integers are compressed losslessly, with or without the delta
+    return lzCompressChunksBound(daSize, prec, 0, LZ_PRED_NONE);
+}
+
+
+int lzCompressInt(uchar *dstBuf, ulong *outSize, void *daBuf, ulong daSize, ushort prec, short level, int transform, int nbThreads)
+{ // Signed integers of prec bytes, transform is LZ_INT_DELTA and/or LZ_INT_ZIGZAG, zigzag pays for signed values or deltas
+    return lzCompressChunks(NULL, dstBuf, outSize, (uchar *)daBuf, daSize, LZ_TYPE_INT, prec, level, 0, NULL, NULL, transform, nbThreads);
+}
+
+
+int lzUncompressInt(void *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, ushort prec, int nbThreads)
+{ // The transforms are read from the container, the width must be the one compressed
+    lzInfo info;
+    if ((lzGetInfo(&info, srcBuf, inSize) != EXIT_SUCCESS) || (info.prec != prec)) return EXIT_FAILURE;
+    return lzUncompressChunks(NULL, (uchar *)daBuf, darSize, srcBuf, inSize, LZ_TYPE_INT, NULL, nbThreads);
+}
+
+
+int lzCompressUInt(uchar *dstBuf, ulong *outSize, void *daBuf, ulong daSize, ushort prec, short level, int transform, int nbThreads)
+{
+    return lzCompressChunks(NULL, dstBuf, outSize, (uchar *)daBuf, daSize, LZ_TYPE_UINT, prec, level, 0, NULL, NULL, transform, nbThreads);
+}
+
+
+int lzUncompressUInt(void *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, ushort prec, int nbThreads)
+{
+    lzInfo info;
+    if ((lzGetInfo(&info, srcBuf, inSize) != EXIT_SUCCESS) || (info.prec != prec)) return EXIT_FAILURE;
+    return lzUncompressChunks(NULL, (uchar *)daBuf, darSize, srcBuf, inSize, LZ_TYPE_UINT, NULL, nbThreads);
+}
+
+
+ulong lzCompressHalfBound(ulong daSize, short protect)
+{ // Both 16-bit formats, protect counts the kept bits of the 16
+    return lzCompressChunksBound(daSize, sizeof(ushort), (sizeof(ushort)*8)-protect, LZ_PRED_NONE);
+}
+
+
+int lzCompressHalf(uchar *dstBuf, ulong *outSize, ushort *daBuf, ulong daSize, short level, short protect)
+{ // IEEE binary16, only the LAST, DELTA and STRIDE2 predictors apply, any other falls back to none
+    short lossy = (sizeof(ushort)*8)-protect;
+    return lzCompressChunks(NULL, dstBuf, outSize, (uchar *)daBuf, daSize, LZ_TYPE_HALF, sizeof(ushort), level, lossy, NULL, NULL, 0, 1);
+}
+
+
+int lzUncompressHalf(ushort *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+{
+    return lzUncompressChunks(NULL, (uchar *)daBuf, darSize, srcBuf, inSize, LZ_TYPE_HALF, NULL, 1);
+}
+
+
+int lzCompressBFloat(uchar *dstBuf, ulong *outSize, ushort *daBuf, ulong daSize, short level, short protect)
+{ // bfloat16, the top half of a float
+    short lossy = (sizeof(ushort)*8)-protect;
+    return lzCompressChunks(NULL, dstBuf, outSize, (uchar *)daBuf, daSize, LZ_TYPE_BFLOAT, sizeof(ushort), level, lossy, NULL, NULL, 0, 1);
+}
+
+
+int lzUncompressBFloat(ushort *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+{
+    return lzUncompressChunks(NULL, (uchar *)daBuf, darSize, srcBuf, inSize, LZ_TYPE_BFLOAT, NULL, 1);
+}
+
+
+int lzCompressFloatAsHalf(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short protect)
+{ // The floats are rounded to halves block by block on the way to the planes, no half copy of the array is made
+    short lossy = (sizeof(ushort)*8)-protect;
+    return lzCompressChunks(NULL, dstBuf, outSize, (uchar *)darBuf, daSize, LZ_TYPE_HALF, sizeof(ushort), level, lossy, NULL, NULL, LZ_HALF_FROM_FLOAT, 1);
+}
+
+
+int lzUncompressHalfToFloat(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+{ // darBuf holds floats, the halves are decoded into its first half and widened in place
+    if (lzUncompressHalf((ushort *)darBuf, darSize, srcBuf, inSize) != EXIT_SUCCESS) return EXIT_FAILURE;
+    return lzHalfToFloat(darBuf, (const ushort *)darBuf, *darSize);
+}
+
+
+int lzCompressFloatAsBFloat(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short protect)
+{
+    short lossy = (sizeof(ushort)*8)-protect;
+    return lzCompressChunks(NULL, dstBuf, outSize, (uchar *)darBuf, daSize, LZ_TYPE_BFLOAT, sizeof(ushort), level, lossy, NULL, NULL, LZ_BFLOAT_FROM_FLOAT, 1);
+}
+
+
+int lzUncompressBFloatToFloat(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+{
+    if (lzUncompressBFloat((ushort *)darBuf, darSize, srcBuf, inSize) != EXIT_SUCCESS) return EXIT_FAILURE;
+    return lzBFloatToFloat(darBuf, (const ushort *)darBuf, *darSize);
+}
+
+
+short lzErrorProtect(const uchar *daBuf, ulong nbEle, ushort prec, double absErr, int quant)
+{ // Bits to keep so that quantization with quant stays within absErr, -1 for a bad precision
+    const unsigned int *fBuf = (const unsigned int *)daBuf;
+    const ulong *dBuf = (const ulong *)daBuf;
+    ulong i, e, top = 0, expMask = (prec == 8) ? 0x7FF0000000000000UL : 0x7F800000UL;
+    int k, lossy, special = 0, mant = (prec == 8) ? 52 : 23, bias = (prec == 8) ? 1023 : 127;
+
+    if ((prec != 4) && (prec != 8)) return -1;
+    if (!(absErr > 0)) return prec*8;
+    if (prec == 8)
+    { // Largest exponent, NaN and Inf apart
+        for (i = 0; i < nbEle; i++)
+        {
+            e = dBuf[i] & expMask;
+            special = special | (e == expMask);
+            if ((e != expMask) && (e > top)) top = e;
+        }
+    } else {
+        for (i = 0; i < nbEle; i++)
+        {
+            e = fBuf[i] & expMask;
+            special = special | (e == expMask);
+            if ((e != expMask) && (e > top)) top = e;
+        }
+    }
+    e = top >> mant;
+    if (e == 0) e = 1; // Subnormals have the step of the smallest normals
+    if (isinf(absErr)) lossy = prec*8;
+    else
+    { // Dropping lossy bits below the step 2^(e-bias-mant) loses less than 2^(e-bias-mant+lossy)
+        frexp(absErr, &k);
+        lossy = (k-1)+mant-((int)e-bias);
+    }
+    if (lossy > mant) lossy = prec*8; // absErr is then above every magnitude, zero is close enough
+    else if ((quant == LZ_QUANT_ROUND) && (lossy >= 0) && (lossy < mant) && (top != expMask-(1UL << mant))) lossy++; // Half the step, unless the top can overflow
+    if (special && (lossy > mant-1)) lossy = mant-1; // Keeps NaN from turning into Inf
+    if (lossy < 0) lossy = 0;
+    return (prec*8)-lossy;
+}
+
+
+static inline ulong lzDropError(ulong m, ulong low, int round)
+{ // Steps lost when the bits of low are dropped from the integer mantissa m
+    ulong r = m & low;
+    if (round && (r > (low >> 1))) r = low+1-r;
+    return r;
+}
+
+
+short lzRelProtect(const uchar *daBuf, ulong nbEle, ushort prec, double relErr, int quant)
+{ // Bits to keep so that every element stays within relErr of itself, -1 for a bad precision
+    const unsigned int *fBuf = (const unsigned int *)daBuf;
+    const ulong *dBuf = (const ulong *)daBuf;
+    ulong i, v, m, e, low, expMask = (prec == 8) ? 0x7FF0000000000000UL : 0x7F800000UL;
+    int lossy, round, special = 0, mant = (prec == 8) ? 52 : 23;
+
+    if ((prec != 4) && (prec != 8)) return -1;
+    if (!(relErr > 0)) return prec*8;
+    lossy = (relErr >= 1) ? prec*8 : mant;
+    low = (lossy == 64) ? ~0UL : (1UL << lossy)-1;
+    for (i = 0; i < nbEle; i++)
+    { // The error check is fused with the search: lossy only goes down, to what the worst element allows
+        v = (prec == 8) ? dBuf[i] : fBuf[i];
+        e = v & expMask;
+        if (e == expMask)
+        {
+            special = 1;
+            continue;
+        }
+        if (lossy > mant) continue; // Dropping everything loses at most the element itself
+        m = (v & ((1UL << mant)-1)) | ((e != 0) ? 1UL << mant : 0);
+        round = (quant == LZ_QUANT_ROUND) && (e != expMask-(1UL << mant)); // The top exponent truncates rather than overflow
+        while (lzDropError(m, low, round) > relErr*m)
+        {
+            lossy--;
+            low = low >> 1;
+        }
+    }
+    if (special && (lossy > mant-1)) lossy = mant-1; // Keeps NaN from turning into Inf
+    return (prec*8)-lossy;
+}
+
+
+int lzCompressFloatRelBound(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, double relErr)
+{
+    return lzCompressFloat(dstBuf, outSize, darBuf, daSize, level, lzRelProtect((uchar *)darBuf, daSize, sizeof(float), relErr, LZ_QUANT_TRUNCATE));
+}
+
+
+int lzCompressDoubleRelBound(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, double relErr)
+{
+    return lzCompressDouble(dstBuf, outSize, daBuf, daSize, level, lzRelProtect((uchar *)daBuf, daSize, sizeof(double), relErr, LZ_QUANT_TRUNCATE));
+}
+
+
+int lzCompressFloatErrorBound(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, double absErr)
+{
+    return lzCompressFloat(dstBuf, outSize, darBuf, daSize, level, lzErrorProtect((uchar *)darBuf, daSize, sizeof(float), absErr, LZ_QUANT_TRUNCATE));
+}
+
+
+int lzCompressDoubleErrorBound(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, double absErr)
+{
+    return lzCompressDouble(dstBuf, outSize, daBuf, daSize, level, lzErrorProtect((uchar *)daBuf, daSize, sizeof(double), absErr, LZ_QUANT_TRUNCATE));
+}
+
+
+int lzUncompressFloatRange(float *darBuf, uchar *srcBuf, ulong inSize, ulong first, ulong count)
+{
+    return lzUncompressRange((uchar *)darBuf, srcBuf, inSize, LZ_TYPE_FLOAT, sizeof(float), first, count);
+}
+
+
+int lzUncompressDoubleRange(double *daBuf, uchar *srcBuf, ulong inSize, ulong first, ulong count)
+{
+    return lzUncompressRange((uchar *)daBuf, srcBuf, inSize, LZ_TYPE_DOUBLE, sizeof(double), first, count);
+}
+
+
+ulong lzCompressFloatBound(ulong daSize, short protect)
+{ // Whatever the predictor of the context, the Lorenzo one keeps every bit and needs the most
+    return lzCompressChunksBound(daSize, sizeof(float), (sizeof(float)*8)-protect, LZ_PRED_LORENZO);
+}
+
+
+ulong lzCompressDoubleBound(ulong daSize, short protect)
+{
+    return lzCompressChunksBound(daSize, sizeof(double), (sizeof(double)*8)-protect, LZ_PRED_LORENZO);
+}
+
+
+ulong lzCompressFloatChunkedBound(ulong daSize, short protect)
+{
+    return lzCompressFloatBound(daSize, protect);
+}
+
+
+ulong lzCompressDoubleChunkedBound(ulong daSize, short protect)
+{
+    return lzCompressDoubleBound(daSize, protect);
+}
+
+
+int lzCompressFloatCtx(lzContext *ctx, uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short protect)
+{
+    short lossy = (sizeof(float)*8)-protect;
+    return lzCompressChunks(ctx, dstBuf, outSize, (uchar *)darBuf, daSize, LZ_TYPE_FLOAT, sizeof(float), level, lossy, NULL, NULL, 0, 1);
+}
+
+
+int lzCompressFloat(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short protect)
+{
+    return lzCompressFloatCtx(NULL, dstBuf, outSize, darBuf, daSize, level, protect);
+}
+
+
+int lzUncompressFloatCtx(lzDContext *dctx, float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+{
+    ushort size = sizeof(float);
+    if (lzIsContainer(srcBuf, inSize)) return lzUncompressChunks(dctx, (uchar *)darBuf, darSize, srcBuf, inSize, LZ_TYPE_FLOAT, NULL, 1);
+    return lzUncompressLockstep(dctx, (uchar *)darBuf, darSize, srcBuf, inSize, size);
+}
+
+
+int lzUncompressFloat(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+{
+    int res;
+    lzDContext *dctx = lzCreateDContext();
+    if (dctx == NULL) return EXIT_FAILURE;
+    res = lzUncompressFloatCtx(dctx, darBuf, darSize, srcBuf, inSize);
+    lzDestroyDContext(dctx);
+    return res;
+}
+
+
+int lzCompressDoubleCtx(lzContext *ctx, uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short protect)
+{
+    float t0;
+    struct timeval start, end;
+    short lossy = (sizeof(double)*8) - protect;
+    int res;
+
+    gettimeofday(&start, NULL);
+    res = lzCompressChunks(ctx, dstBuf, outSize, (uchar *)daBuf, daSize, LZ_TYPE_DOUBLE, sizeof(double), level, lossy, NULL, NULL, 0, 1);
+    gettimeofday(&end, NULL);
+    t0 = end.tv_sec-start.tv_sec+((end.tv_usec-start.tv_usec)/1000000.0);
+    if (VERBOSE) printf("Reformatting and compression time : %f \n", t0);
+    return res;
+}
+
+
+int lzCompressDouble(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short protect)
+{
+    return lzCompressDoubleCtx(NULL, dstBuf, outSize, daBuf, daSize, level, protect);
+}
+
+
+int lzUncompressDoubleCtx(lzDContext *dctx, double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+{
+    ushort size = sizeof(double);
+    if (lzIsContainer(srcBuf, inSize)) return lzUncompressChunks(dctx, (uchar *)daBuf, darSize, srcBuf, inSize, LZ_TYPE_DOUBLE, NULL, 1);
+    return lzUncompressLockstep(dctx, (uchar *)daBuf, darSize, srcBuf, inSize, size);
+}
+
+
+int lzUncompressDouble(double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+{
+    int res;
+    lzDContext *dctx = lzCreateDContext();
+    if (dctx == NULL) return EXIT_FAILURE;
+    res = lzUncompressDoubleCtx(dctx, daBuf, darSize, srcBuf, inSize);
+    lzDestroyDContext(dctx);
+    return res;
+}
+
+
+int lzCompressFloatCtxMT(lzContext *ctx, uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short protect, int nbThreads)
+{ // The workers take the lzSelect* choices of ctx, a dictionary keeps the compression on the caller's thread
+    short lossy = (sizeof(float)*8)-protect;
+    return lzCompressChunks(ctx, dstBuf, outSize, (uchar *)darBuf, daSize, LZ_TYPE_FLOAT, sizeof(float), level, lossy, NULL, NULL, 0, nbThreads);
+}
+
+
+int lzCompressFloatMT(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short protect, int nbThreads)
+{
+    return lzCompressFloatCtxMT(NULL, dstBuf, outSize, darBuf, daSize, level, protect, nbThreads);
+}
+
+
+int lzCompressDoubleCtxMT(lzContext *ctx, uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short protect, int nbThreads)
+{
+    short lossy = (sizeof(double)*8)-protect;
+    return lzCompressChunks(ctx, dstBuf, outSize, (uchar *)daBuf, daSize, LZ_TYPE_DOUBLE, sizeof(double), level, lossy, NULL, NULL, 0, nbThreads);
+}
+
+
+int lzCompressDoubleMT(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short protect, int nbThreads)
+{
+    return lzCompressDoubleCtxMT(NULL, dstBuf, outSize, daBuf, daSize, level, protect, nbThreads);
+}
+
+
+int lzUncompressFloatMT(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize, int nbThreads)
+{
+    if (lzIsContainer(srcBuf, inSize)) return lzUncompressChunks(NULL, (uchar *)darBuf, darSize, srcBuf, inSize, LZ_TYPE_FLOAT, NULL, nbThreads);
+    return lzUncompressLegacyMT((uchar *)darBuf, darSize, srcBuf, inSize, sizeof(float), nbThreads);
+}
+
+
+int lzUncompressDoubleMT(double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, int nbThreads)
+{
+    if (lzIsContainer(srcBuf, inSize)) return lzUncompressChunks(NULL, (uchar *)daBuf, darSize, srcBuf, inSize, LZ_TYPE_DOUBLE, NULL, nbThreads);
+    return lzUncompressLegacyMT((uchar *)daBuf, darSize, srcBuf, inSize, sizeof(double), nbThreads);
+}
+
+
+int lzCompressFloatChunked(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short protect, int nbThreads)
+{
+    return lzCompressFloatMT(dstBuf, outSize, darBuf, daSize, level, protect, nbThreads);
+}
+
+
+int lzUncompressFloatChunked(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize, int nbThreads)
+{
+    return lzUncompressFloatMT(darBuf, darSize, srcBuf, inSize, nbThreads);
+}
+
+
+int lzCompressDoubleChunked(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short protect, int nbThreads)
+{
+    return lzCompressDoubleMT(dstBuf, outSize, daBuf, daSize, level, protect, nbThreads);
+}
+
+
+int lzUncompressDoubleChunked(double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, int nbThreads)
+{
+    return lzUncompressDoubleMT(daBuf, darSize, srcBuf, inSize, nbThreads);
+}
@@ -25,19 +25,146 @@ extern "C" {
 
 #define FORCE_COMP          1
 #define VERBOSE             0
-#define BYTE_FREQ           1
 #define MAX_LEVEL           9
 #define LIT_ENDIAN          1
-#define MAX_STATS           10000
+#define MAX_STATS           16384
+#define STATS_BLOCKS        16
+#define MAX_ENTROPY         7.9
+#define MAX_SYMBOLS         16
+#define RUN_BITS            16
+#define PACK_BITS           4
+#define PRED_BITS           14
+#define QUANT_SIZE          (16 * 1024)
 #define BUF_SIZE            (1024 * 1024)
+#define MAX_THREADS         256
+#define CHUNK_SIZE          BUF_SIZE
+#define TILE_SIZE           BUF_SIZE
+#define WINDOW_SIZE         (16 * 1024)
+#define LZ_DICT_SIZE        (32 * 1024)
+#define LZ_MAGIC            "\x89LZF"
+#define LZ_VERSION          4
+#define LZ_HEADER_SIZE      48
+#define LZ_ENTRY_SIZE       20
+#define LZ_GRID_SIZE        24
+#define LZ_TYPE_FLOAT       1
+#define LZ_TYPE_DOUBLE      2
+#define LZ_TYPE_INT         3
+#define LZ_TYPE_UINT        4
+#define LZ_TYPE_HALF        5
+#define LZ_TYPE_BFLOAT      6
 #define compress            mz_compress
 #define compress2           mz_compress2
 #define uncompress          mz_uncompress
+#define LZ_ISA_SCALAR       0
+#define LZ_ISA_SSE2         1
+#define LZ_ISA_AVX2         2
+#define LZ_MODE_DEFLATE     0
+#define LZ_MODE_ADAPTIVE    1
+#define LZ_PRED_NONE        0
+#define LZ_PRED_LAST        1
+#define LZ_PRED_DELTA       2
+#define LZ_PRED_STRIDE2     3
+#define LZ_PRED_FCM         4
+#define LZ_PRED_DFCM        5
+#define LZ_PRED_LORENZO     6
+#define LZ_FLAG_PRED        0x07
+#define LZ_FLAG_DELTA       0x08
+#define LZ_FLAG_DICT        0x10
+#define LZ_FLAG_ZIGZAG      0x20
+#define LZ_FLAG_NARROW      0x40
+#define LZ_INT_DELTA        1
+#define LZ_INT_ZIGZAG       2
+#define LZ_HALF_FROM_FLOAT  4
+#define LZ_BFLOAT_FROM_FLOAT 8
+#define LZ_FLOAT_FROM_DOUBLE 16
+#define LZ_QUANT_TRUNCATE   0
+#define LZ_QUANT_ROUND      1
+#define LZ_NARROW_NEVER     0
+#define LZ_NARROW_FLOAT     1
 
 typedef unsigned long ulong;
 typedef unsigned char uchar;
 typedef unsigned short ushort;
 
+typedef void (*lzTaskFunc)(void *arg, int task, int worker);
+
+typedef int (*lzWriteFunc)(void *user, const uchar *buf, ulong size);
+
+typedef struct lzContext
+{
+    void *comp;             // Deflate state (tdefl_compressor), reset for every plane
+    uchar *planes[8];       // Byte planes of the array being compressed
+    ulong planeSize;        // Capacity of each plane
+    ushort nbPlanes;        // Number of planes allocated
+    uchar *resBuf;          // Residuals of the predictor, split instead of the array
+    ulong resSize;          // Capacity of resBuf
+    uchar *dict[8];         // Preset dictionary of each plane, see lzSetDictionary
+    ulong dictSize;         // Bytes in each dictionary plane, 0 without a dictionary
+    ushort dictPrec;        // Number of dictionary planes
+    int mode;               // LZ_MODE_* set by lzSelectMode
+    int predictor;          // LZ_PRED_* set by lzSelectPredictor
+    int quantizer;          // LZ_QUANT_* set by lzSelectQuantizer
+    int narrowing;          // LZ_NARROW_* set by lzSelectNarrowing
+} lzContext;
+
+typedef struct lzWindow
+{
+    void *decomp;           // Inflate state (tinfl_decompressor) of one plane
+    uchar *dict;            // Circular buffer with the last 32 KB inflated
+    const uchar *srcBuf;    // Deflate input not consumed yet
+    ulong inSize;           // Bytes left in srcBuf
+    ulong dictOfs;          // Where the next inflated byte goes in dict
+    ulong dictAvail;        // Inflated bytes not delivered yet, right before dictOfs
+    int status;             // Last tinfl status
+} lzWindow;
+
+typedef struct lzDContext
+{
+    void *decomp;           // Inflate state (tinfl_decompressor), reset for every plane
+    lzWindow win[8];        // Inflate states of the lockstep decoder, one per plane
+    uchar *planes[8];       // Byte planes of the array being decompressed
+    ulong planeSize;        // Capacity of each plane
+    ushort nbPlanes;        // Number of planes allocated
+    uchar *dict[8];         // Preset dictionary of each plane, the same as the compressor's
+    ulong dictSize;         // Bytes in each dictionary plane, 0 without a dictionary
+    ushort dictPrec;        // Number of dictionary planes
+} lzDContext;
+
+typedef struct lzStream
+{
+    void *comp[8];          // Deflate state (tdefl_compressor) of each plane, open for the whole array
+    uchar *planes[8];       // Byte planes of the current tile
+    uchar *outBuf[8];       // Deflate output of the current tile
+    ulong tileEle;          // Elements per tile
+    ulong fill;             // Elements in the current tile
+    ulong nbEle;            // Elements fed so far
+    ulong outSize;          // Capacity of each outBuf
+    lzWriteFunc write;      // Receives the compressed bytes, returns EXIT_SUCCESS or EXIT_FAILURE
+    void *user;             // First argument of write
+    int code[8];            // Plane layout, as in lzCompressFlopnt
+    int status;             // EXIT_FAILURE once a tile or a write failed
+    ushort prec;
+    short level;
+    short lossy;
+} lzStream;
+
+typedef struct lzInfo
+{
+    ulong nbEle;            // Number of elements, 0 for legacy streams
+    ulong nbBytes;          // Size of the uncompressed array in bytes
+    ulong chunkEle;         // Elements per chunk
+    ulong nbChunks;         // Entries of the chunk table
+    ulong dataOffset;       // Where the chunk data starts
+    short lossy;            // Bits dropped per element
+    uchar version;          // LZ_VERSION, 0 for legacy streams
+    uchar type;             // LZ_TYPE_*, 0 for legacy streams
+    uchar prec;             // Bytes per element, 0 for legacy streams
+    uchar predictor;        // LZ_PRED_* applied to each chunk before the split
+    uchar flags;            // LZ_FLAG_* bits of the header besides the predictor
+    ulong dims[3];          // Grid of a Lorenzo container, x fastest, (nbEle, 1, 1) otherwise
+    signed char code[8];    // Plane layout, as in lzCompressFlopnt
+} lzInfo;
+
 typedef union ldouble
 {
     double value;
@@ -52,16 +179,136 @@ typedef union lfloat
     char byte[4];
 } lfloat;
 
-extern int   compress(uchar *pDest, ulong *pDest_len, uchar *pSource, ulong source_len);
-extern int  compress2(uchar *pDest, ulong *pDest_len, uchar *pSource, ulong source_len, int level);
-extern int uncompress(uchar *pDest, ulong *pDest_len, uchar *pSource, ulong source_len);
+extern int   compress(uchar *pDest, ulong *pDest_len, const uchar *pSource, ulong source_len);
+extern int  compress2(uchar *pDest, ulong *pDest_len, const uchar *pSource, ulong source_len, int level);
+extern int uncompress(uchar *pDest, ulong *pDest_len, const uchar *pSource, ulong source_len);
 
+extern ulong          lzCompressBound(ulong inSize);
+extern ulong     lzCompressFloatBound(ulong daSize, short lossy);
+extern ulong    lzCompressDoubleBound(ulong daSize, short lossy);
+extern ulong lzCompressFloatChunkedBound(ulong daSize, short lossy);
+extern ulong lzCompressDoubleChunkedBound(ulong daSize, short lossy);
 extern int         lzCompress(uchar *dstBuf, ulong *outSize, uchar *srcBuf, ulong inSize, short level);
 extern int       lzUncompress(uchar *dstBuf, ulong *outSize, uchar *srcBuf, ulong inSize);
 extern int    lzCompressFloat(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short lossy);
 extern int  lzUncompressFloat(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize);
 extern int   lzCompressDouble(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short lossy);
 extern int lzUncompressDouble(double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize);
+extern lzContext     *lzCreateContext(void);
+extern int           lzDestroyContext(lzContext *ctx);
+extern lzDContext   *lzCreateDContext(void);
+extern int          lzDestroyDContext(lzDContext *dctx);
+extern int    lzCompressFloatCtx(lzContext *ctx, uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short lossy);
+extern int  lzUncompressFloatCtx(lzDContext *dctx, float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize);
+extern int   lzCompressDoubleCtx(lzContext *ctx, uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short lossy);
+extern int lzUncompressDoubleCtx(lzDContext *dctx, double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize);
+extern int       lzSetDictionary(lzContext *ctx, const uchar *sample, ulong nbEle, ushort prec, short lossy);
+extern int      lzSetDDictionary(lzDContext *dctx, const uchar *sample, ulong nbEle, ushort prec, short lossy);
+extern int  lzCompressFloatMT(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short lossy, int nbThreads);
+extern int lzCompressDoubleMT(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short lossy, int nbThreads);
+extern int  lzCompressFloatCtxMT(lzContext *ctx, uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short lossy, int nbThreads);
+extern int lzCompressDoubleCtxMT(lzContext *ctx, uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short lossy, int nbThreads);
+extern int  lzUncompressFloatMT(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize, int nbThreads);
+extern int lzUncompressDoubleMT(double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, int nbThreads);
+extern int    lzCompressFloatChunked(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short lossy, int nbThreads);
+extern int  lzUncompressFloatChunked(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize, int nbThreads);
+extern int   lzCompressDoubleChunked(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, short lossy, int nbThreads);
+extern int lzUncompressDoubleChunked(double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, int nbThreads);
+extern int          lzGetInfo(lzInfo *info, uchar *srcBuf, ulong inSize);
+extern int  lzUncompressFloatRange(float *darBuf, uchar *srcBuf, ulong inSize, ulong first, ulong count);
+extern int lzUncompressDoubleRange(double *daBuf, uchar *srcBuf, ulong inSize, ulong first, ulong count);
+extern int      lzIsContainer(uchar *srcBuf, ulong inSize);
+extern ulong  lzCompressFloat3DBound(ulong nx, ulong ny, ulong nz, short lossy);
+extern ulong lzCompressDouble3DBound(ulong nx, ulong ny, ulong nz, short lossy);
+extern int       lzCompressFloat3D(uchar *dstBuf, ulong *outSize, float *darBuf, ulong nx, ulong ny, ulong nz, short level, short lossy);
+extern int     lzUncompressFloat3D(float *darBuf, ulong *nx, ulong *ny, ulong *nz, uchar *srcBuf, ulong inSize);
+extern int      lzCompressDouble3D(uchar *dstBuf, ulong *outSize, double *daBuf, ulong nx, ulong ny, ulong nz, short level, short lossy);
+extern int    lzUncompressDouble3D(double *daBuf, ulong *nx, ulong *ny, ulong *nz, uchar *srcBuf, ulong inSize);
+extern int    lzCompressFloatDelta(uchar *dstBuf, ulong *outSize, float *darBuf, const float *refBuf, ulong daSize, short level, short lossy, int nbThreads);
+extern int  lzUncompressFloatDelta(float *darBuf, ulong *darSize, const float *refBuf, uchar *srcBuf, ulong inSize, int nbThreads);
+extern int   lzCompressDoubleDelta(uchar *dstBuf, ulong *outSize, double *daBuf, const double *refBuf, ulong daSize, short level, short lossy, int nbThreads);
+extern int lzUncompressDoubleDelta(double *daBuf, ulong *darSize, const double *refBuf, uchar *srcBuf, ulong inSize, int nbThreads);
+extern ulong       lzCompressIntBound(ulong daSize, ushort prec);
+extern int            lzCompressInt(uchar *dstBuf, ulong *outSize, void *daBuf, ulong daSize, ushort prec, short level, int transform, int nbThreads);
+extern int          lzUncompressInt(void *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, ushort prec, int nbThreads);
+extern int           lzCompressUInt(uchar *dstBuf, ulong *outSize, void *daBuf, ulong daSize, ushort prec, short level, int transform, int nbThreads);
+extern int         lzUncompressUInt(void *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, ushort prec, int nbThreads);
+extern ulong      lzCompressHalfBound(ulong daSize, short lossy);
+extern int           lzCompressHalf(uchar *dstBuf, ulong *outSize, ushort *daBuf, ulong daSize, short level, short lossy);
+extern int         lzUncompressHalf(ushort *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize);
+extern int         lzCompressBFloat(uchar *dstBuf, ulong *outSize, ushort *daBuf, ulong daSize, short level, short lossy);
+extern int       lzUncompressBFloat(ushort *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize);
+extern int    lzCompressFloatAsHalf(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short lossy);
+extern int  lzUncompressHalfToFloat(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize);
+extern int  lzCompressFloatAsBFloat(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, short lossy);
+extern int lzUncompressBFloatToFloat(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize);
+extern short        lzErrorProtect(const uchar *daBuf, ulong nbEle, ushort prec, double absErr, int quant);
+extern int  lzCompressFloatErrorBound(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, double absErr);
+extern int lzCompressDoubleErrorBound(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, double absErr);
+extern short          lzRelProtect(const uchar *daBuf, ulong nbEle, ushort prec, double relErr, int quant);
+extern int    lzCompressFloatRelBound(uchar *dstBuf, ulong *outSize, float *darBuf, ulong daSize, short level, double relErr);
+extern int   lzCompressDoubleRelBound(uchar *dstBuf, ulong *outSize, double *daBuf, ulong daSize, short level, double relErr);
+
+extern lzStream        *lzStreamInit(ushort prec, short level, short lossy, lzWriteFunc write, void *user);
+extern int              lzStreamFeed(lzStream *strm, const void *daBuf, ulong nbEle);
+extern int             lzStreamFlush(lzStream *strm);
+extern int               lzStreamEnd(lzStream *strm);
+extern ulong          lzStreamLength(uchar *srcBuf, ulong inSize);
+extern int   lzUncompressFloatStream(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize);
+extern int  lzUncompressDoubleStream(double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize);
+
+extern int       lzSelectMode(lzContext *ctx, int mode);
+extern int  lzSelectPredictor(lzContext *ctx, int pred);
+extern int  lzSelectQuantizer(lzContext *ctx, int quant);
+extern int   lzSelectNarrowing(lzContext *ctx, int narrow);
+extern int   lzSplitQuantized(uchar **planes, const uchar *src, ulong n, ushort prec, short lossy, int round);
+extern int          lzPredict(uchar *resBuf, const uchar *daBuf, ulong n, ushort prec, int pred, short lossy);
+extern int        lzUnpredict(uchar *daBuf, ulong n, ushort prec, int pred);
+extern int           lzZigzag(uchar *buf, ulong n, ushort prec);
+extern int         lzUnzigzag(uchar *buf, ulong n, ushort prec);
+extern int          lzLorenzo(uchar *resBuf, const uchar *daBuf, const ulong dims[3], ulong first, ulong n, ushort prec, short lossy, int round);
+extern int        lzUnlorenzo(uchar *daBuf, const ulong dims[3], ushort prec, short lossy);
+extern int    entropyAnalysis(uchar *tmpBuf, ulong size, int code, short lossy);
+extern int            getCode(int code[8], ushort prec, short lossy);
+extern int          maskArray(uchar *tmpBuf, ulong offset, short lossy);
+extern int      lzEncodePlane(uchar *dstBuf, ulong *outSize, uchar *tmpBuf, ulong offset, int code);
+extern int      lzDecodePlane(uchar *dstBuf, uchar *srcBuf, ulong parSize, ulong first, ulong n, int code);
+extern int       lzEncodeBits(void *comp, uchar *dstBuf, ulong *outSize, uchar *tmpBuf, ulong offset, int bits, int code, short level);
+extern int       lzDecodeBits(void *decomp, uchar *dstBuf, uchar *srcBuf, ulong parSize, ulong n);
+extern int       lzOpenWindow(lzWindow *win, const uchar *srcBuf, ulong inSize);
+extern int      lzPrimeWindow(lzWindow *win, const uchar *dict, ulong dictSize);
+extern int      lzCloseWindow(lzWindow *win);
+extern int    lzInflateWindow(lzWindow *win, uchar *dstBuf, ulong outSize, int drain, int last);
+
+extern int     lzSupportedIsa(void);
+extern int        lzSelectIsa(int isa);
+extern int      lzSplitPlanes(uchar **planes, const uchar *src, ulong n, ushort prec);
+extern void     lzSplitScalar(uchar **planes, const uchar *src, ulong n, ushort prec);
+extern int     lzGatherPlanes(uchar *dst, uchar **planes, ulong n, ushort prec);
+extern void    lzGatherScalar(uchar *dst, uchar **planes, ulong n, ushort prec);
+extern int      lzUnpackPlane(uchar *dst, const uchar *src, ulong first, ulong n, int bits, const uchar *dict);
+extern void    lzUnpackScalar(uchar *dst, const uchar *src, ulong first, ulong n, int bits, const uchar *dict);
+extern int         lzPackBits(uchar *dst, const uchar *src, ulong n, int bits);
+extern void  lzPackBitsScalar(uchar *dst, const uchar *src, ulong n, int bits);
+extern int       lzUnpackBits(uchar *dst, const uchar *src, ulong first, ulong n, int bits);
+extern void lzUnpackBitsScalar(uchar *dst, const uchar *src, ulong first, ulong n, int bits);
+extern int        lzPrefixXor(uchar *buf, ulong n, ushort prec, int stride);
+extern int        lzPrefixAdd(uchar *buf, ulong n, ushort prec);
+extern void    lzPrefixScalar(uchar *buf, ulong n, ushort prec, int stride, int add);
+extern int         lzQuantize(uchar *dst, const uchar *src, ulong n, ushort prec, short lossy, int round);
+extern void  lzQuantizeScalar(uchar *dst, const uchar *src, ulong n, ushort prec, short lossy, int round);
+extern int      lzFloatToHalf(ushort *dst, const float *src, ulong n);
+extern void lzFloatToHalfScalar(ushort *dst, const float *src, ulong n);
+extern int      lzHalfToFloat(float *dst, const ushort *src, ulong n);
+extern void lzHalfToFloatScalar(float *dst, const ushort *src, ulong n);
+extern int    lzFloatToBFloat(ushort *dst, const float *src, ulong n);
+extern int    lzBFloatToFloat(float *dst, const ushort *src, ulong n);
+extern int        lzFitsFloat(const double *src, ulong n);
+extern int    lzDoubleToFloat(float *dst, const double *src, ulong n);
+extern int    lzFloatToDouble(double *dst, const float *src, ulong n);
+extern void       lzHistogram(unsigned int count[256], const uchar *buf, ulong n);
+extern int      lzParallelFor(int nbThreads, int nbTasks, lzTaskFunc task, void *arg);
+extern int     lzPoolShutdown(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,194 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  lzpool.c
+ *
+ *    Description:  Thread pool of the lz floating point compression library
+ *
+ *        Version:  1.0
+ *        Created:  10/18/2026 10:00:00 AM CDT
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Leonardo A. Bautista Gomez (leobago@anl.gov),
+ *        Company:  Argonne National Laboratory
+ *
+ * =====================================================================================
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "lz.h"
+
+
+/*
+ * Work-stealing pool. A parallel loop deals its task indices in contiguous
+ * ranges to the deques of the participating workers. A worker pops tasks from
+ * the front of its own deque and, once it is empty, steals single tasks from
+ * the back of the others, so uneven tasks (e.g. noisy chunks that deflate
+ * slowly) do not leave cores idle. The calling thread is always worker 0 and
+ * the pool threads are created on demand and kept for the next loops.
+ */
+
+typedef struct lzDeque
+{
+    pthread_mutex_t lock;
+    int lo;
+    int hi;
+} lzDeque;
+
+typedef struct lzPool
+{
+    pthread_mutex_t busy;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    pthread_t threads[MAX_THREADS];
+    lzDeque deques[MAX_THREADS];
+    lzTaskFunc task;
+    void *arg;
+    int nbWorkers;
+    int active;
+    int pending;
+    int generation;
+    int shutdown;
+} lzPool;
+
+static lzPool lzThePool = {.busy = PTHREAD_MUTEX_INITIALIZER, .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER, .done = PTHREAD_COND_INITIALIZER};
+static pthread_once_t lzPoolOnce = PTHREAD_ONCE_INIT;
+static __thread int lzInWorker = 0;
+
+
+static void lzInitPool(void)
+{
+    int i;
+    for (i = 0; i < MAX_THREADS; i++) pthread_mutex_init(&(lzThePool.deques[i].lock), NULL);
+}
+
+
+static int lzPopTask(lzDeque *deque, int back)
+{
+    int i = -1;
+    pthread_mutex_lock(&(deque->lock));
+    if (deque->lo < deque->hi)
+    {
+        if (back)
+        {
+            deque->hi = deque->hi - 1;
+            i = deque->hi;
+        } else {
+            i = deque->lo;
+            deque->lo = deque->lo + 1;
+        }
+    }
+    pthread_mutex_unlock(&(deque->lock));
+    return i;
+}
+
+
+static void lzRunTasks(lzPool *pool, int id)
+{
+    int i, k, victim;
+    while ((i = lzPopTask(pool->deques+id, 0)) >= 0) pool->task(pool->arg, i, id);
+    for (k = 1; k < pool->active; k++)
+    { // Own deque is empty, steal from the others
+        victim = (id+k)%pool->active;
+        while ((i = lzPopTask(pool->deques+victim, 1)) >= 0) pool->task(pool->arg, i, id);
+    }
+}
+
+
+static void *lzRunWorker(void *arg)
+{
+    lzPool *pool = &lzThePool;
+    int id = (int)(long)arg, generation = 0;
+    lzInWorker = 1;
+    pthread_mutex_lock(&(pool->lock));
+    while (1)
+    {
+        while ((!pool->shutdown) && (pool->generation == generation)) pthread_cond_wait(&(pool->wake), &(pool->lock));
+        if (pool->shutdown) break;
+        generation = pool->generation;
+        if (id >= pool->active) continue;
+        pthread_mutex_unlock(&(pool->lock));
+        lzRunTasks(pool, id);
+        pthread_mutex_lock(&(pool->lock));
+        pool->pending = pool->pending - 1;
+        if (pool->pending == 0) pthread_cond_signal(&(pool->done));
+    }
+    pthread_mutex_unlock(&(pool->lock));
+    return NULL;
+}
+
+
+static int lzGrowPool(lzPool *pool, int nbThreads)
+{ // Worker 0 is the caller, so nbThreads-1 pool threads are needed
+    while (pool->nbWorkers+1 < nbThreads)
+    {
+        int id = pool->nbWorkers+1;
+        if (pthread_create(pool->threads+id, NULL, lzRunWorker, (void *)(long)id) != 0) break;
+        pool->nbWorkers = pool->nbWorkers + 1;
+    }
+    return pool->nbWorkers+1;
+}
+
+
+int lzParallelFor(int nbThreads, int nbTasks, lzTaskFunc task, void *arg)
+{
+    lzPool *pool = &lzThePool;
+    int i, active;
+
+    if (nbThreads > MAX_THREADS) nbThreads = MAX_THREADS;
+    if (nbThreads > nbTasks) nbThreads = nbTasks;
+    if ((nbThreads <= 1) || (lzInWorker) || (pthread_mutex_trylock(&(pool->busy)) != 0))
+    { // Serial loop: one thread asked, nested loop or pool used by another caller
+        for (i = 0; i < nbTasks; i++) task(arg, i, 0);
+        return EXIT_SUCCESS;
+    }
+    pthread_once(&lzPoolOnce, lzInitPool);
+    pthread_mutex_lock(&(pool->lock));
+    active = lzGrowPool(pool, nbThreads);
+    if (active > nbThreads) active = nbThreads;
+    for (i = 0; i < active; i++)
+    {
+        pool->deques[i].lo = (int)(((long)nbTasks*i)/active);
+        pool->deques[i].hi = (int)(((long)nbTasks*(i+1))/active);
+    }
+    pool->task = task;
+    pool->arg = arg;
+    pool->active = active;
+    pool->pending = active-1;
+    pool->generation = pool->generation + 1;
+    pthread_cond_broadcast(&(pool->wake));
+    pthread_mutex_unlock(&(pool->lock));
+    lzInWorker = 1;
+    lzRunTasks(pool, 0);
+    lzInWorker = 0;
+    pthread_mutex_lock(&(pool->lock));
+    while (pool->pending > 0) pthread_cond_wait(&(pool->done), &(pool->lock));
+    pthread_mutex_unlock(&(pool->lock));
+    pthread_mutex_unlock(&(pool->busy));
+    return EXIT_SUCCESS;
+}
+
+
+int lzPoolShutdown(void)
+{
+    lzPool *pool = &lzThePool;
+    int i;
+    pthread_mutex_lock(&(pool->busy));
+    pthread_mutex_lock(&(pool->lock));
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&(pool->wake));
+    pthread_mutex_unlock(&(pool->lock));
+    for (i = 1; i <= pool->nbWorkers; i++) pthread_join(pool->threads[i], NULL);
+    pthread_mutex_lock(&(pool->lock));
+    pool->nbWorkers = 0;
+    pool->shutdown = 0;
+    pthread_mutex_unlock(&(pool->lock));
+    pthread_mutex_unlock(&(pool->busy));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,355 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  lzpred.c
+ *
+ *    Description:  Predictor stage of the lz floating point compression library
+ *
+ *        Version:  1.0
+ *        Created:  10/18/2026 02:00:00 PM CDT
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Leonardo A. Bautista Gomez (leobago@anl.gov),
+ *        Company:  Argonne National Laboratory
+ *
+ * =====================================================================================
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "lz.h"
+
+
+/*
+ * The predictors work on the bit patterns of the elements of one chunk. Each
+ * element is replaced by its XOR (or difference) with a prediction made from
+ * the elements before it, so smooth data leaves mostly zero high bytes to the
+ * planes. Lossy compression clears the dropped bits before predicting: the
+ * residuals then have them clear as well and the lost and masked planes hold
+ * nothing the inverse needs.
+ *
+ *   LZ_PRED_LAST     v[i] ^ v[i-1]
+ *   LZ_PRED_DELTA    v[i] - v[i-1]
+ *   LZ_PRED_STRIDE2  v[i] ^ v[i-2], for interleaved pairs such as complex numbers
+ *   LZ_PRED_FCM      v[i] ^ the value that followed the same context of high bits last time
+ *   LZ_PRED_DFCM     v[i] ^ (v[i-1] + the delta that followed the same context of deltas last time)
+ *
+ * The first three are undone with the prefix scans of lzsimd.c, the context
+ * predictors need their tables rebuilt in order and are undone serially.
+ * Integer arrays of any width from 1 to 8 bytes may use the first three, and
+ * zigzag (lzZigzag) the residuals so small differences of either sign leave
+ * the high planes clear.
+ */
+
+static ulong lzKeepMask(ushort prec, short lossy)
+{ // Bits kept by a lossy compression, within the element
+    ulong keep = (prec == 8) ? ~0UL : (1UL << (prec*8))-1;
+    if (lossy >= prec*8) return 0;
+    return keep & ~((1UL << lossy)-1);
+}
+
+
+static int lzRunContext(uchar *dstBuf, const uchar *srcBuf, ulong n, ushort prec, ulong keep, int pred, int inverse)
+{ // Both directions of FCM and DFCM, the tables are fed with the values in either case
+    ulong i, v, r, p, delta, last = 0, hash = 0, size = 1UL << PRED_BITS;
+    ulong width = (prec == 8) ? ~0UL : 0xFFFFFFFFUL, *table = calloc(size, sizeof(ulong));
+    int bits = prec*8;
+    if (table == NULL) return EXIT_FAILURE;
+    for (i = 0; i < n; i++)
+    {
+        p = (pred == LZ_PRED_FCM) ? table[hash] : (last+table[hash]) & width;
+        r = 0;
+        memcpy(&r, srcBuf+(i*prec), prec);
+        v = inverse ? r^p : r & keep;
+        r = v^p;
+        memcpy(dstBuf+(i*prec), inverse ? &v : &r, prec);
+        if (pred == LZ_PRED_FCM)
+        {
+            table[hash] = v;
+            hash = ((hash << 6) ^ (v >> (bits-16))) & (size-1);
+        } else {
+            delta = (v-last) & width;
+            table[hash] = delta;
+            hash = ((hash << 2) ^ (delta >> (bits-24))) & (size-1);
+        }
+        last = v;
+    }
+    free(table);
+    return EXIT_SUCCESS;
+}
+
+
+int lzPredict(uchar *resBuf, const uchar *daBuf, ulong n, ushort prec, int pred, short lossy)
+{ // resBuf gets the residuals of the n elements of daBuf, it may be daBuf: the loops run backwards
+    ulong i, v, p, keep = lzKeepMask(prec, lossy);
+    const unsigned int *d4 = (const unsigned int *)daBuf;
+    const ulong *d8 = (const ulong *)daBuf;
+    unsigned int *r4 = (unsigned int *)resBuf;
+    ulong *r8 = (ulong *)resBuf;
+    ulong stride = (pred == LZ_PRED_STRIDE2) ? 2 : 1;
+    if ((prec < 1) || (prec > 8)) return EXIT_FAILURE;
+    if (((pred == LZ_PRED_FCM) || (pred == LZ_PRED_DFCM)) && ((prec == 4) || (prec == 8))) return lzRunContext(resBuf, daBuf, n, prec, keep, pred, 0);
+    if ((pred != LZ_PRED_LAST) && (pred != LZ_PRED_DELTA) && (pred != LZ_PRED_STRIDE2)) return EXIT_FAILURE;
+    if ((prec != 4) && (prec != 8))
+    { // Other integer widths, an element at a time
+        for (i = n; i > 0; i--)
+        {
+            v = 0;
+            p = 0;
+            memcpy(&v, daBuf+((i-1)*prec), prec);
+            if (i > stride) memcpy(&p, daBuf+((i-1-stride)*prec), prec);
+            v = (pred == LZ_PRED_DELTA) ? (v & keep)-(p & keep) : (v ^ p) & keep;
+            memcpy(resBuf+((i-1)*prec), &v, prec);
+        }
+        return EXIT_SUCCESS;
+    }
+    if ((prec == 4) && (pred == LZ_PRED_DELTA)) for (i = n; i > 1; i--) r4[i-1] = (d4[i-1] & keep)-(d4[i-2] & keep);
+    if ((prec == 4) && (pred != LZ_PRED_DELTA)) for (i = n; i > stride; i--) r4[i-1] = (d4[i-1] ^ d4[i-1-stride]) & keep;
+    if ((prec == 8) && (pred == LZ_PRED_DELTA)) for (i = n; i > 1; i--) r8[i-1] = (d8[i-1] & keep)-(d8[i-2] & keep);
+    if ((prec == 8) && (pred != LZ_PRED_DELTA)) for (i = n; i > stride; i--) r8[i-1] = (d8[i-1] ^ d8[i-1-stride]) & keep;
+    for (i = 0; (i < stride) && (i < n); i++)
+    {
+        if (prec == 4) r4[i] = d4[i] & keep;
+        else r8[i] = d8[i] & keep;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int lzUnpredict(uchar *daBuf, ulong n, ushort prec, int pred)
+{ // In place, the residuals of daBuf become the elements again
+    if ((prec < 1) || (prec > 8)) return EXIT_FAILURE;
+    if ((prec != 4) && (prec != 8) && (pred != LZ_PRED_NONE) && (pred != LZ_PRED_LAST) && (pred != LZ_PRED_DELTA) && (pred != LZ_PRED_STRIDE2)) return EXIT_FAILURE;
+    switch (pred)
+    {
+        case LZ_PRED_NONE: return EXIT_SUCCESS;
+        case LZ_PRED_LAST: return lzPrefixXor(daBuf, n, prec, 1);
+        case LZ_PRED_STRIDE2: return lzPrefixXor(daBuf, n, prec, 2);
+        case LZ_PRED_DELTA: return lzPrefixAdd(daBuf, n, prec);
+        case LZ_PRED_FCM:
+        case LZ_PRED_DFCM: return lzRunContext(daBuf, daBuf, n, prec, 0, pred, 1);
+        case LZ_PRED_LORENZO: return EXIT_SUCCESS; // Undone on the whole grid, see lzUnlorenzo
+    }
+    return EXIT_FAILURE;
+}
+
+
+static void lzZigzagRun(uchar *buf, ulong n, ushort prec, int inverse)
+{ // Both directions, 4 and 8 byte elements get loops the compiler can vectorize
+    ulong i, v, width = (prec == 8) ? ~0UL : (1UL << (prec*8))-1, top = 1UL << ((prec*8)-1);
+    unsigned int *b4 = (unsigned int *)buf;
+    ulong *b8 = (ulong *)buf;
+    if ((prec == 4) && (!inverse)) for (i = 0; i < n; i++) b4[i] = (b4[i] << 1) ^ (unsigned int)((int)b4[i] >> 31);
+    else if (prec == 4) for (i = 0; i < n; i++) b4[i] = (b4[i] >> 1) ^ (0U-(b4[i] & 1));
+    else if ((prec == 8) && (!inverse)) for (i = 0; i < n; i++) b8[i] = (b8[i] << 1) ^ (ulong)((long)b8[i] >> 63);
+    else if (prec == 8) for (i = 0; i < n; i++) b8[i] = (b8[i] >> 1) ^ (0UL-(b8[i] & 1));
+    else for (i = 0; i < n; i++)
+    {
+        v = 0;
+        memcpy(&v, buf+(i*prec), prec);
+        if (inverse) v = ((v >> 1) ^ (0UL-(v & 1))) & width;
+        else v = ((v << 1) ^ (0UL-((v & top) != 0))) & width;
+        memcpy(buf+(i*prec), &v, prec);
+    }
+}
+
+
+int lzZigzag(uchar *buf, ulong n, ushort prec)
+{ // In place, the two's complement elements ..., -2, -1, 0, 1, 2, ... become 3, 1, 0, 2, 4, ...
+    if ((prec < 1) || (prec > 8)) return EXIT_FAILURE;
+    lzZigzagRun(buf, n, prec, 0);
+    return EXIT_SUCCESS;
+}
+
+
+int lzUnzigzag(uchar *buf, ulong n, ushort prec)
+{
+    if ((prec < 1) || (prec > 8)) return EXIT_FAILURE;
+    lzZigzagRun(buf, n, prec, 1);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Lorenzo predictor of a grid of nx*ny*nz elements, x running fastest. Each
+ * element is predicted from its neighbours before it along every axis,
+ *
+ *   p(x,y,z) = u(x-1,y,z)+u(x,y-1,z)+u(x,y,z-1)
+ *             -u(x-1,y-1,z)-u(x-1,y,z-1)-u(x,y-1,z-1)+u(x-1,y-1,z-1)
+ *
+ * that is, the residual is the product of the backward differences along the
+ * three axes. It runs on integers: the dropped bits are shifted out (rounded
+ * first when asked, as lzQuantize does) and the sign-magnitude pattern left
+ * is mapped to an ordered integer, so the arithmetic is exact modulo 2^bits
+ * and the residuals, zigzagged, are small on smooth fields. The forward pass
+ * is pointwise and streams four rows at a time, so any range of elements (a
+ * chunk) is predicted on its own. The inverse is separable: a prefix sum
+ * along x with the scan kernel, then the rows above and behind are added,
+ * row after row, and every row goes back to floating point as soon as no
+ * later row needs it.
+ */
+
+typedef struct lzGridMap
+{
+    ulong width;            // Mask of the element bits
+    ulong sign;             // Sign bit once the dropped bits are shifted out
+    ulong mask;             // Mask of the bits kept
+    ulong half;             // Added before the shift to round, 0 to truncate
+    ulong expMask;          // Exponent bits, NaN, Inf and overflows are truncated
+    int shift;              // Dropped bits
+    int bits;               // Bits per element
+    ushort prec;
+} lzGridMap;
+
+
+static int lzSetGridMap(lzGridMap *map, ushort prec, short lossy, int round)
+{ // EXIT_FAILURE when nothing is kept, the whole grid is then zero
+    int kept = (prec*8)-lossy;
+    map->half = (round && (lossy > 0) && (lossy <= ((prec == 8) ? 52 : 23))) ? 1UL << (lossy-1) : 0;
+    map->expMask = (prec == 8) ? 0x7FF0000000000000UL : 0x7F800000UL;
+    map->prec = prec;
+    map->bits = prec*8;
+    map->shift = lossy;
+    map->width = (prec == 8) ? ~0UL : 0xFFFFFFFFUL;
+    if ((lossy < 0) || (kept <= 0)) return EXIT_FAILURE;
+    map->sign = 1UL << (kept-1);
+    map->mask = (kept == 64) ? ~0UL : (1UL << kept)-1;
+    return EXIT_SUCCESS;
+}
+
+
+static inline ulong lzGetEle(const uchar *row, ulong x, ushort prec)
+{
+    return (prec == 8) ? ((const ulong *)row)[x] : ((const unsigned int *)row)[x];
+}
+
+
+static inline void lzSetEle(uchar *row, ulong x, ulong v, ushort prec)
+{
+    if (prec == 8) ((ulong *)row)[x] = v;
+    else ((unsigned int *)row)[x] = (unsigned int)v;
+}
+
+
+static inline ulong lzToOrdered(ulong v, const lzGridMap *map)
+{ // Negative values below positive ones, both in increasing order
+    ulong r = v+map->half;
+    if (((r & map->expMask) != map->expMask) && ((v & map->expMask) != map->expMask)) v = r;
+    v = v >> map->shift;
+    return v ^ (map->sign ^ ((0-((v & map->sign) != 0)) & (map->mask ^ map->sign)));
+}
+
+
+static inline ulong lzFromOrdered(ulong u, const lzGridMap *map)
+{
+    u = u & map->mask;
+    return (u ^ (map->sign ^ ((0-((u & map->sign) == 0)) & (map->mask ^ map->sign)))) << map->shift;
+}
+
+
+static inline ulong lzDiffYZ(const uchar *cur, const uchar *up, const uchar *back, const uchar *diag, ulong x, ulong mu, ulong mb, ulong md, const lzGridMap *map, ushort prec)
+{ // Product of the backward differences along y and z, a missing one is masked out
+    ulong w = lzToOrdered(lzGetEle(cur, x, prec), map);
+    w = w-(lzToOrdered(lzGetEle(up, x, prec), map) & mu);
+    w = w-(lzToOrdered(lzGetEle(back, x, prec), map) & mb);
+    return (w+(lzToOrdered(lzGetEle(diag, x, prec), map) & md)) & map->width;
+}
+
+
+static inline void lzLorenzoSpan(uchar *resBuf, const uchar *cur, const uchar *up, const uchar *back, const uchar *diag, ulong x0, ulong x1, const lzGridMap *map, ushort prec)
+{ // Inlined with a constant prec, neither loop carries a value from one element to the next
+    ulong x, r, width = map->width, topBit = 1UL << (map->bits-1);
+    ulong mu = (up != cur) ? ~0UL : 0, mb = (back != cur) ? ~0UL : 0, md = (diag != cur) ? ~0UL : 0;
+    ulong wl = (x0 > 0) ? lzDiffYZ(cur, up, back, diag, x0-1, mu, mb, md, map, prec) : 0;
+    for (x = x0; x < x1; x++) lzSetEle(resBuf, x-x0, lzDiffYZ(cur, up, back, diag, x, mu, mb, md, map, prec), prec);
+    for (x = x1-x0-1; x > 0; x--)
+    { // Then along x, backwards so that every element still reads its left neighbour
+        r = (lzGetEle(resBuf, x, prec)-lzGetEle(resBuf, x-1, prec)) & width;
+        lzSetEle(resBuf, x, ((r << 1) ^ (0-((r & topBit) != 0))) & width, prec);
+    }
+    r = (lzGetEle(resBuf, 0, prec)-wl) & width;
+    lzSetEle(resBuf, 0, ((r << 1) ^ (0-((r & topBit) != 0))) & width, prec);
+}
+
+
+static void lzLorenzoRow(uchar *resBuf, const uchar *cur, const uchar *up, const uchar *back, const uchar *diag, ulong x0, ulong x1, const lzGridMap *map)
+{ // Residuals of elements [x0, x1) of a row, a missing neighbour row is given as cur and masked out
+    if (map->prec == 8) lzLorenzoSpan(resBuf, cur, up, back, diag, x0, x1, map, 8);
+    else lzLorenzoSpan(resBuf, cur, up, back, diag, x0, x1, map, 4);
+}
+
+
+int lzLorenzo(uchar *resBuf, const uchar *daBuf, const ulong dims[3], ulong first, ulong n, ushort prec, short lossy, int round)
+{ // resBuf gets the zigzagged residuals of elements [first, first+n) of the grid daBuf
+    lzGridMap map;
+    const uchar *cur;
+    ulong idx, x, y, z, x1, nx = dims[0], ny = dims[1], plane = dims[0]*dims[1], end = first+n;
+    if ((prec != 4) && (prec != 8)) return EXIT_FAILURE;
+    if ((nx == 0) || (ny == 0) || (end > plane*dims[2])) return EXIT_FAILURE;
+    if (lzSetGridMap(&map, prec, lossy, round) != EXIT_SUCCESS)
+    {
+        memset(resBuf, 0, n*prec);
+        return EXIT_SUCCESS;
+    }
+    for (idx = first; idx < end; idx = idx+(x1-x))
+    { // Row by row, the rows above and behind are read straight from the grid
+        x = idx%nx;
+        y = (idx/nx)%ny;
+        z = idx/plane;
+        x1 = (end-idx < nx-x) ? x+(end-idx) : nx;
+        cur = daBuf+((idx-x)*prec);
+        lzLorenzoRow(resBuf+((idx-first)*prec), cur, (y > 0) ? cur-(nx*prec) : cur, (z > 0) ? cur-(plane*prec) : cur,
+                ((y > 0) && (z > 0)) ? cur-((plane+nx)*prec) : cur, x, x1, &map);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int lzUnlorenzo(uchar *daBuf, const ulong dims[3], ushort prec, short lossy)
+{ // In place, the residuals of the whole grid become the elements again
+    lzGridMap map;
+    uchar *row, *up, *back, *diag;
+    ulong k, x, u, nx = dims[0], ny = dims[1], rows = dims[1]*dims[2], lag = (dims[2] > 1) ? dims[1]+1 : 1;
+    ulong mu, mb, md, width;
+    if ((prec != 4) && (prec != 8)) return EXIT_FAILURE;
+    if ((nx == 0) || (ny == 0)) return EXIT_FAILURE;
+    if (lzSetGridMap(&map, prec, lossy, 0) != EXIT_SUCCESS)
+    {
+        memset(daBuf, 0, nx*rows*prec);
+        return EXIT_SUCCESS;
+    }
+    width = map.width;
+    for (k = 0; k < rows; k++)
+    {
+        row = daBuf+(k*nx*prec);
+        mu = ((k%ny) > 0) ? ~0UL : 0;
+        mb = (k >= ny) ? ~0UL : 0;
+        md = mu & mb;
+        up = mu ? row-(nx*prec) : row;
+        back = mb ? row-(ny*nx*prec) : row;
+        diag = md ? back-(nx*prec) : row;
+        for (x = 0; x < nx; x++)
+        {
+            u = lzGetEle(row, x, prec);
+            lzSetEle(row, x, ((u >> 1) ^ ((u & 1) ? width : 0)) & width, prec);
+        }
+        lzPrefixAdd(row, nx, prec);
+        for (x = 0; (x < nx) && (mu | mb); x++)
+        {
+            u = lzGetEle(row, x, prec)+(lzGetEle(up, x, prec) & mu)+(lzGetEle(back, x, prec) & mb)-(lzGetEle(diag, x, prec) & md);
+            lzSetEle(row, x, u, prec);
+        }
+        if (k < lag) continue;
+        row = daBuf+((k-lag)*nx*prec);
+        for (x = 0; x < nx; x++) lzSetEle(row, x, lzFromOrdered(lzGetEle(row, x, prec), &map), prec);
+    }
+    for (k = (rows > lag) ? rows-lag : 0; k < rows; k++)
+    { // Rows still needed when the grid ended
+        row = daBuf+(k*nx*prec);
+        for (x = 0; x < nx; x++) lzSetEle(row, x, lzFromOrdered(lzGetEle(row, x, prec), &map), prec);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1399 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  lzsimd.c
+ *
+ *    Description:  Vectorized kernels of the lz floating point compression library
+ *
+ *        Version:  1.0
+ *        Created:  10/18/2026 09:00:00 AM CDT
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Leonardo A. Bautista Gomez (leobago@anl.gov),
+ *        Company:  Argonne National Laboratory
+ *
+ * =====================================================================================
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <pthread.h>
+#include "lz.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LZ_X86              1
+#include <immintrin.h>
+#else
+#define LZ_X86              0
+#endif
+
+#if LZ_X86 && defined(__x86_64__)
+#define LZ_BMI2             1
+#else
+#define LZ_BMI2             0
+#endif
+
+
+typedef void (*lzSplitFunc)(uchar **planes, const uchar *src, ulong n);
+typedef void (*lzGatherFunc)(uchar *dst, uchar **planes, ulong n);
+typedef void (*lzUnpackFunc)(uchar *dst, const uchar *src, ulong nbBytes, const uchar *dict);
+typedef void (*lzBitsFunc)(uchar *dst, const uchar *src, ulong groups, ulong avail, int bits);
+typedef void (*lzNarrowFunc)(ushort *dst, const float *src, ulong n);
+typedef void (*lzWidenFunc)(float *dst, const ushort *src, ulong n);
+typedef void (*lzToFloatFunc)(float *dst, const double *src, ulong n);
+typedef void (*lzToDoubleFunc)(double *dst, const float *src, ulong n);
+typedef int (*lzFitsFunc)(const double *src, ulong n);
+
+static int lzIsa = -1;
+static pthread_once_t lzIsaOnce = PTHREAD_ONCE_INIT;
+static lzSplitFunc lzSplit2 = NULL, lzSplit4 = NULL, lzSplit8 = NULL;
+static lzGatherFunc lzGather2 = NULL, lzGather4 = NULL, lzGather8 = NULL;
+static lzUnpackFunc lzUnpack4 = NULL;
+static lzBitsFunc lzPackGroups = NULL, lzUnpackGroups = NULL;
+static lzNarrowFunc lzToHalf = NULL, lzToBFloat = NULL;
+static lzWidenFunc lzFromHalf = NULL, lzFromBFloat = NULL;
+static lzToFloatFunc lzToFloat = NULL;
+static lzToDoubleFunc lzToDouble = NULL;
+static lzFitsFunc lzFits = NULL;
+
+
+/*
+ * Scalar kernels, used for the tails of the vector kernels and on machines
+ * (or element widths) without a vector implementation.
+ */
+
+void lzSplitScalar(uchar **planes, const uchar *src, ulong n, ushort prec)
+{
+    ulong i;
+    ushort j;
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < prec; j++) planes[j][i] = src[j];
+        src = src + prec;
+    }
+}
+
+static void lzSplit2Scalar(uchar **planes, const uchar *src, ulong n)
+{
+    ulong i;
+    uchar *p0 = planes[0], *p1 = planes[1];
+    for (i = 0; i < n; i++)
+    {
+        p0[i] = src[2*i]; p1[i] = src[(2*i)+1];
+    }
+}
+
+static void lzSplit4Scalar(uchar **planes, const uchar *src, ulong n)
+{
+    ulong i;
+    uchar *p0 = planes[0], *p1 = planes[1], *p2 = planes[2], *p3 = planes[3];
+    for (i = 0; i < n; i++)
+    {
+        p0[i] = src[0]; p1[i] = src[1]; p2[i] = src[2]; p3[i] = src[3];
+        src = src + 4;
+    }
+}
+
+static void lzSplit8Scalar(uchar **planes, const uchar *src, ulong n)
+{
+    ulong i;
+    uchar *p0 = planes[0], *p1 = planes[1], *p2 = planes[2], *p3 = planes[3];
+    uchar *p4 = planes[4], *p5 = planes[5], *p6 = planes[6], *p7 = planes[7];
+    for (i = 0; i < n; i++)
+    {
+        p0[i] = src[0]; p1[i] = src[1]; p2[i] = src[2]; p3[i] = src[3];
+        p4[i] = src[4]; p5[i] = src[5]; p6[i] = src[6]; p7[i] = src[7];
+        src = src + 8;
+    }
+}
+
+void lzGatherScalar(uchar *dst, uchar **planes, ulong n, ushort prec)
+{
+    ulong i;
+    ushort j;
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < prec; j++) dst[j] = planes[j][i];
+        dst = dst + prec;
+    }
+}
+
+static void lzGather2Scalar(uchar *dst, uchar **planes, ulong n)
+{
+    ulong i;
+    uchar *p0 = planes[0], *p1 = planes[1];
+    for (i = 0; i < n; i++)
+    {
+        dst[2*i] = p0[i]; dst[(2*i)+1] = p1[i];
+    }
+}
+
+static void lzGather4Scalar(uchar *dst, uchar **planes, ulong n)
+{
+    ulong i;
+    uchar *p0 = planes[0], *p1 = planes[1], *p2 = planes[2], *p3 = planes[3];
+    for (i = 0; i < n; i++)
+    {
+        dst[0] = p0[i]; dst[1] = p1[i]; dst[2] = p2[i]; dst[3] = p3[i];
+        dst = dst + 4;
+    }
+}
+
+static void lzGather8Scalar(uchar *dst, uchar **planes, ulong n)
+{
+    ulong i;
+    uchar *p0 = planes[0], *p1 = planes[1], *p2 = planes[2], *p3 = planes[3];
+    uchar *p4 = planes[4], *p5 = planes[5], *p6 = planes[6], *p7 = planes[7];
+    for (i = 0; i < n; i++)
+    {
+        dst[0] = p0[i]; dst[1] = p1[i]; dst[2] = p2[i]; dst[3] = p3[i];
+        dst[4] = p4[i]; dst[5] = p5[i]; dst[6] = p6[i]; dst[7] = p7[i];
+        dst = dst + 8;
+    }
+}
+
+void lzUnpackScalar(uchar *dst, const uchar *src, ulong first, ulong n, int bits, const uchar *dict)
+{ // Element k of a packed plane is dict[index k], indices fill each byte from its low bits
+    ulong i, k;
+    int mask = (1 << bits)-1;
+    for (i = 0; i < n; i++)
+    {
+        k = (first+i)*bits;
+        dst[i] = dict[(src[k/8] >> (k%8)) & mask];
+    }
+}
+
+static void lzUnpackTable(uchar *dst, const uchar *src, ulong nbBytes, int bits, const uchar *dict)
+{ // Every packed byte expands to 8/bits elements, copied from a table built for dict
+    uchar table[256][8];
+    ulong i;
+    int b, j, per = 8/bits, mask = (1 << bits)-1;
+    for (b = 0; b < 256; b++) for (j = 0; j < per; j++) table[b][j] = dict[(b >> (j*bits)) & mask];
+    switch (bits)
+    {
+        case 1: for (i = 0; i < nbBytes; i++) memcpy(dst+(8*i), table[src[i]], 8); break;
+        case 2: for (i = 0; i < nbBytes; i++) memcpy(dst+(4*i), table[src[i]], 4); break;
+        default: for (i = 0; i < nbBytes; i++) memcpy(dst+(2*i), table[src[i]], 2);
+    }
+}
+
+static void lzUnpack4Scalar(uchar *dst, const uchar *src, ulong nbBytes, const uchar *dict)
+{
+    lzUnpackTable(dst, src, nbBytes, 4, dict);
+}
+
+void lzPrefixScalar(uchar *buf, ulong n, ushort prec, int stride, int add)
+{ // Running XOR (or sum) of the elements stride apart, the inverse of the LAST, STRIDE2 and DELTA predictors
+    ulong i, v, p;
+    for (i = stride; i < n; i++)
+    {
+        v = 0;
+        p = 0;
+        memcpy(&v, buf+(i*prec), prec);
+        memcpy(&p, buf+((i-stride)*prec), prec);
+        v = add ? v+p : v^p;
+        memcpy(buf+(i*prec), &v, prec);
+    }
+}
+
+static void lzQuantizeMasks(ushort prec, short lossy, int round, ulong *keep, ulong *half)
+{ // Rounding stays within the mantissa, dropping exponent bits always truncates
+    // 2-byte elements may be fp16 or bf16: both have 7 mantissa bits at least, and the fp16
+    // exponent test of lzQuantizeTail only makes bf16 from 2^121 up truncate instead of round
+    int mant = (prec == 8) ? 52 : ((prec == 4) ? 23 : 7);
+    ulong width = (prec == 8) ? ~0UL : (1UL << (prec*8))-1;
+    *keep = (lossy >= prec*8) ? 0 : width & ~((1UL << lossy)-1);
+    *half = (round && (lossy > 0) && (lossy <= mant)) ? 1UL << (lossy-1) : 0;
+}
+
+static void lzQuantizeTail(uchar *dst, const uchar *src, ulong n, ushort prec, ulong keep, ulong half)
+{
+    ulong i, v, r, expMask = (prec == 8) ? 0x7FF0000000000000UL : ((prec == 4) ? 0x7F800000UL : 0x7C00UL);
+    for (i = 0; i < n; i++)
+    {
+        v = 0;
+        memcpy(&v, src+(i*prec), prec);
+        r = (v+half) & keep;
+        if (((v & expMask) == expMask) || ((r & expMask) == expMask)) r = v & keep;
+        memcpy(dst+(i*prec), &r, prec);
+    }
+}
+
+void lzQuantizeScalar(uchar *dst, const uchar *src, ulong n, ushort prec, short lossy, int round)
+{ // The dropped bits rounded to nearest (ties away from zero) or truncated, NaN, Inf and overflows truncated
+    ulong keep, half;
+    lzQuantizeMasks(prec, lossy, round, &keep, &half);
+    lzQuantizeTail(dst, src, n, prec, keep, half);
+}
+
+static void lzPackTail(uchar *dst, const uchar *src, ulong n, int bits)
+{ // At most 8 elements, the high bits of element j go to bit j*bits of a little endian word
+    ulong j, w = 0;
+    for (j = 0; j < n; j++) w = w | ((ulong)(src[j] >> (8-bits)) << (j*bits));
+    for (j = 0; j < ((n*bits)+7)/8; j++) dst[j] = w >> (8*j);
+}
+
+static void lzUnpackTail(uchar *dst, const uchar *src, ulong n, int bits)
+{ // At most 8 elements, every source byte is read before the first one is written
+    ulong j, w = 0;
+    for (j = 0; j < ((n*bits)+7)/8; j++) w = w | ((ulong)src[j] << (8*j));
+    for (j = 0; j < n; j++) dst[j] = ((w >> (j*bits)) & ((1 << bits)-1)) << (8-bits);
+}
+
+static void lzPackGroupsScalar(uchar *dst, const uchar *src, ulong groups, ulong avail, int bits)
+{ // 8 elements to bits bytes
+    ulong g;
+    (void)avail;
+    for (g = 0; g < groups; g++) lzPackTail(dst+(g*bits), src+(8*g), 8, bits);
+}
+
+static void lzUnpackGroupsScalar(uchar *dst, const uchar *src, ulong groups, ulong avail, int bits)
+{
+    ulong g;
+    (void)avail;
+    for (g = 0; g < groups; g++) lzUnpackTail(dst+(8*g), src+(g*bits), 8, bits);
+}
+
+void lzPackBitsScalar(uchar *dst, const uchar *src, ulong n, int bits)
+{
+    lzPackGroupsScalar(dst, src, n/8, 0, bits);
+    lzPackTail(dst+((n/8)*bits), src+(8*(n/8)), n%8, bits);
+}
+
+void lzUnpackBitsScalar(uchar *dst, const uchar *src, ulong first, ulong n, int bits)
+{ // Element k of a bit packed plane is bits bits from bit k*bits, put back as the high bits of its byte
+    ulong i, k;
+    unsigned int v;
+    for (i = 0; i < n; i++)
+    {
+        k = (first+i)*bits;
+        v = src[k/8] >> (k%8);
+        if ((k%8)+bits > 8) v = v | (src[(k/8)+1] << (8-(k%8)));
+        dst[i] = (v & ((1 << bits)-1)) << (8-bits);
+    }
+}
+
+
+/*
+ * Half precision conversions, rounding to nearest even as the hardware does.
+ * fp16 has 5 exponent and 10 mantissa bits, bf16 is the high half of a float
+ * (8 and 7). Overflows become Inf, NaNs stay NaN with the quiet bit set.
+ * Widening runs from the last element down, so the floats may be written
+ * over the halves they come from; narrowing runs up and may do the same.
+ */
+
+static unsigned short lzHalfOf(unsigned int x)
+{
+    unsigned int sign = (x >> 16) & 0x8000, e = (x >> 23) & 0xFF, m = x & 0x7FFFFF, r, rest, shift;
+    if (e == 0xFF) return sign | 0x7C00 | ((m != 0) ? 0x200 | (m >> 13) : 0);
+    if (e > 142) return sign | 0x7C00;
+    if (e < 102) return sign;
+    if (e >= 113)
+    { // Normal, a carry out of the mantissa bumps the exponent, up to Inf
+        r = ((e-112) << 10) | (m >> 13);
+        rest = m & 0x1FFF;
+        return sign | (r+((rest > 0x1000) || ((rest == 0x1000) && (r & 1))));
+    }
+    m = m | 0x800000;
+    shift = 126-e;
+    r = m >> shift;
+    rest = m & ((1U << shift)-1);
+    return sign | (r+((rest > (1U << (shift-1))) || ((rest == (1U << (shift-1))) && (r & 1))));
+}
+
+static unsigned int lzFloatOf(unsigned short h)
+{
+    unsigned int sign = ((unsigned int)h & 0x8000) << 16, e = (h >> 10) & 0x1F, m = h & 0x3FF;
+    if (e == 0x1F) return sign | 0x7F800000 | (m << 13) | ((m != 0) ? 0x400000 : 0);
+    if (e != 0) return sign | ((e+112) << 23) | (m << 13);
+    if (m == 0) return sign;
+    for (e = 113; (m & 0x400) == 0; e--) m = m << 1;
+    return sign | (e << 23) | ((m & 0x3FF) << 13);
+}
+
+void lzFloatToHalfScalar(ushort *dst, const float *src, ulong n)
+{
+    ulong i;
+    unsigned int x;
+    for (i = 0; i < n; i++)
+    {
+        memcpy(&x, src+i, 4);
+        dst[i] = lzHalfOf(x);
+    }
+}
+
+void lzHalfToFloatScalar(float *dst, const ushort *src, ulong n)
+{
+    ulong i;
+    unsigned int x;
+    for (i = n; i > 0; i--)
+    {
+        x = lzFloatOf(src[i-1]);
+        memcpy(dst+i-1, &x, 4);
+    }
+}
+
+static void lzFloatToBFloatScalar(ushort *dst, const float *src, ulong n)
+{
+    ulong i;
+    unsigned int x;
+    for (i = 0; i < n; i++)
+    {
+        memcpy(&x, src+i, 4);
+        if ((x & 0x7FFFFFFF) > 0x7F800000) dst[i] = (x >> 16) | 0x40;
+        else dst[i] = (x+0x7FFF+((x >> 16) & 1)) >> 16;
+    }
+}
+
+static void lzBFloatToFloatScalar(float *dst, const ushort *src, ulong n)
+{
+    ulong i;
+    unsigned int x;
+    for (i = n; i > 0; i--)
+    {
+        x = (unsigned int)src[i-1] << 16;
+        memcpy(dst+i-1, &x, 4);
+    }
+}
+
+
+/*
+ * Doubles that came from floats. A double fits when narrowing and widening
+ * it gives back the same bits, which the narrowing of lzDoubleToFloat then
+ * does exactly; float subnormals are refused, as their dropped bits would
+ * cost more relative precision than the double ones. The check stops at the
+ * first block that does not fit, most double arrays fail at once.
+ */
+
+static int lzFitsFloatScalar(const double *src, ulong n)
+{
+    ulong i;
+    double d;
+    float f;
+    for (i = 0; i < n; i++)
+    {
+        f = (float)src[i];
+        d = (double)f;
+        if (memcmp(&d, src+i, sizeof(double)) != 0) return 0;
+        if ((f != 0) && (f < FLT_MIN) && (f > -FLT_MIN)) return 0;
+    }
+    return 1;
+}
+
+static void lzDoubleToFloatScalar(float *dst, const double *src, ulong n)
+{
+    ulong i;
+    for (i = 0; i < n; i++) dst[i] = (float)src[i];
+}
+
+static void lzFloatToDoubleScalar(double *dst, const float *src, ulong n)
+{
+    ulong i;
+    for (i = n; i > 0; i--) dst[i-1] = (double)src[i-1];
+}
+
+
+#if LZ_X86
+
+/*
+ * The vector kernels transpose blocks of 16 (SSE2) or 32 (AVX2) elements.
+ * Seen as a bit address, a byte of the block is [register | lane byte] and
+ * one round of unpacklo/unpackhi between register k and k+N/2 rotates that
+ * address left by one bit. Four rounds move the byte index from the low bits
+ * to the register index, that is, each register ends up holding one plane.
+ * The 256-bit unpacks do not cross 128-bit lanes, so the AVX2 kernels load
+ * the second half of the block in the high lanes and the lane bit becomes
+ * the top bit of the element index. The gather kernels run the same rounds
+ * on the planes: three (8 bytes) or two (4 bytes) more rotations bring the
+ * address back to the element order.
+ */
+
+__attribute__((target("sse2")))
+static void lzSplit2Sse2(uchar **planes, const uchar *src, ulong n)
+{ // Two bytes need no transpose, the low and high bytes of the words are packed apart
+    ulong i, blocks = n/16;
+    __m128i a, b, m = _mm_set1_epi16(0xFF);
+    for (i = 0; i < blocks; i++)
+    {
+        a = _mm_loadu_si128((const __m128i *)(src+(32*i)));
+        b = _mm_loadu_si128((const __m128i *)(src+(32*i)+16));
+        _mm_storeu_si128((__m128i *)(planes[0]+(16*i)), _mm_packus_epi16(_mm_and_si128(a, m), _mm_and_si128(b, m)));
+        _mm_storeu_si128((__m128i *)(planes[1]+(16*i)), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+    if (n%16)
+    {
+        uchar *tail[2] = {planes[0]+(16*blocks), planes[1]+(16*blocks)};
+        lzSplit2Scalar(tail, src+(32*blocks), n%16);
+    }
+}
+
+__attribute__((target("sse2")))
+static void lzSplit4Sse2(uchar **planes, const uchar *src, ulong n)
+{
+    ulong i, blocks = n/16;
+    int k, r;
+    __m128i a[4], t[4];
+    for (i = 0; i < blocks; i++)
+    {
+        for (k = 0; k < 4; k++) a[k] = _mm_loadu_si128((const __m128i *)(src+(16*k)));
+        for (r = 0; r < 4; r++)
+        {
+            for (k = 0; k < 2; k++)
+            {
+                t[2*k] = _mm_unpacklo_epi8(a[k], a[k+2]);
+                t[(2*k)+1] = _mm_unpackhi_epi8(a[k], a[k+2]);
+            }
+            for (k = 0; k < 4; k++) a[k] = t[k];
+        }
+        for (k = 0; k < 4; k++) _mm_storeu_si128((__m128i *)(planes[k]+(16*i)), a[k]);
+        src = src + 64;
+    }
+    if (n%16)
+    {
+        uchar *tail[4];
+        for (k = 0; k < 4; k++) tail[k] = planes[k]+(16*blocks);
+        lzSplit4Scalar(tail, src, n%16);
+    }
+}
+
+__attribute__((target("sse2")))
+static void lzSplit8Sse2(uchar **planes, const uchar *src, ulong n)
+{
+    ulong i, blocks = n/16;
+    int k, r;
+    __m128i a[8], t[8];
+    for (i = 0; i < blocks; i++)
+    {
+        for (k = 0; k < 8; k++) a[k] = _mm_loadu_si128((const __m128i *)(src+(16*k)));
+        for (r = 0; r < 4; r++)
+        {
+            for (k = 0; k < 4; k++)
+            {
+                t[2*k] = _mm_unpacklo_epi8(a[k], a[k+4]);
+                t[(2*k)+1] = _mm_unpackhi_epi8(a[k], a[k+4]);
+            }
+            for (k = 0; k < 8; k++) a[k] = t[k];
+        }
+        for (k = 0; k < 8; k++) _mm_storeu_si128((__m128i *)(planes[k]+(16*i)), a[k]);
+        src = src + 128;
+    }
+    if (n%16)
+    {
+        uchar *tail[8];
+        for (k = 0; k < 8; k++) tail[k] = planes[k]+(16*blocks);
+        lzSplit8Scalar(tail, src, n%16);
+    }
+}
+
+__attribute__((target("avx2")))
+static __m256i lzLoad2x128(const uchar *lo, const uchar *hi)
+{
+    __m256i v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)lo));
+    return _mm256_inserti128_si256(v, _mm_loadu_si128((const __m128i *)hi), 1);
+}
+
+__attribute__((target("avx2")))
+static void lzSplit4Avx2(uchar **planes, const uchar *src, ulong n)
+{
+    ulong i, blocks = n/32;
+    int k, r;
+    __m256i a[4], t[4];
+    for (i = 0; i < blocks; i++)
+    {
+        for (k = 0; k < 4; k++) a[k] = lzLoad2x128(src+(16*k), src+64+(16*k));
+        for (r = 0; r < 4; r++)
+        {
+            for (k = 0; k < 2; k++)
+            {
+                t[2*k] = _mm256_unpacklo_epi8(a[k], a[k+2]);
+                t[(2*k)+1] = _mm256_unpackhi_epi8(a[k], a[k+2]);
+            }
+            for (k = 0; k < 4; k++) a[k] = t[k];
+        }
+        for (k = 0; k < 4; k++) _mm256_storeu_si256((__m256i *)(planes[k]+(32*i)), a[k]);
+        src = src + 128;
+    }
+    if (n%32)
+    {
+        uchar *tail[4];
+        for (k = 0; k < 4; k++) tail[k] = planes[k]+(32*blocks);
+        lzSplit4Sse2(tail, src, n%32);
+    }
+}
+
+__attribute__((target("avx2")))
+static void lzSplit8Avx2(uchar **planes, const uchar *src, ulong n)
+{
+    ulong i, blocks = n/32;
+    int k, r;
+    __m256i a[8], t[8];
+    for (i = 0; i < blocks; i++)
+    {
+        for (k = 0; k < 8; k++) a[k] = lzLoad2x128(src+(16*k), src+128+(16*k));
+        for (r = 0; r < 4; r++)
+        {
+            for (k = 0; k < 4; k++)
+            {
+                t[2*k] = _mm256_unpacklo_epi8(a[k], a[k+4]);
+                t[(2*k)+1] = _mm256_unpackhi_epi8(a[k], a[k+4]);
+            }
+            for (k = 0; k < 8; k++) a[k] = t[k];
+        }
+        for (k = 0; k < 8; k++) _mm256_storeu_si256((__m256i *)(planes[k]+(32*i)), a[k]);
+        src = src + 256;
+    }
+    if (n%32)
+    {
+        uchar *tail[8];
+        for (k = 0; k < 8; k++) tail[k] = planes[k]+(32*blocks);
+        lzSplit8Sse2(tail, src, n%32);
+    }
+}
+
+__attribute__((target("sse2")))
+static void lzGather2Sse2(uchar *dst, uchar **planes, ulong n)
+{
+    ulong i, blocks = n/16;
+    __m128i lo, hi;
+    for (i = 0; i < blocks; i++)
+    {
+        lo = _mm_loadu_si128((const __m128i *)(planes[0]+(16*i)));
+        hi = _mm_loadu_si128((const __m128i *)(planes[1]+(16*i)));
+        _mm_storeu_si128((__m128i *)(dst+(32*i)), _mm_unpacklo_epi8(lo, hi));
+        _mm_storeu_si128((__m128i *)(dst+(32*i)+16), _mm_unpackhi_epi8(lo, hi));
+    }
+    if (n%16)
+    {
+        uchar *tail[2] = {planes[0]+(16*blocks), planes[1]+(16*blocks)};
+        lzGather2Scalar(dst+(32*blocks), tail, n%16);
+    }
+}
+
+__attribute__((target("sse2")))
+static void lzGather4Sse2(uchar *dst, uchar **planes, ulong n)
+{
+    ulong i, blocks = n/16;
+    int k, r;
+    __m128i a[4], t[4];
+    for (i = 0; i < blocks; i++)
+    {
+        for (k = 0; k < 4; k++) a[k] = _mm_loadu_si128((const __m128i *)(planes[k]+(16*i)));
+        for (r = 0; r < 2; r++)
+        {
+            for (k = 0; k < 2; k++)
+            {
+                t[2*k] = _mm_unpacklo_epi8(a[k], a[k+2]);
+                t[(2*k)+1] = _mm_unpackhi_epi8(a[k], a[k+2]);
+            }
+            for (k = 0; k < 4; k++) a[k] = t[k];
+        }
+        for (k = 0; k < 4; k++) _mm_storeu_si128((__m128i *)(dst+(16*k)), a[k]);
+        dst = dst + 64;
+    }
+    if (n%16)
+    {
+        uchar *tail[4];
+        for (k = 0; k < 4; k++) tail[k] = planes[k]+(16*blocks);
+        lzGather4Scalar(dst, tail, n%16);
+    }
+}
+
+__attribute__((target("sse2")))
+static void lzGather8Sse2(uchar *dst, uchar **planes, ulong n)
+{
+    ulong i, blocks = n/16;
+    int k, r;
+    __m128i a[8], t[8];
+    for (i = 0; i < blocks; i++)
+    {
+        for (k = 0; k < 8; k++) a[k] = _mm_loadu_si128((const __m128i *)(planes[k]+(16*i)));
+        for (r = 0; r < 3; r++)
+        {
+            for (k = 0; k < 4; k++)
+            {
+                t[2*k] = _mm_unpacklo_epi8(a[k], a[k+4]);
+                t[(2*k)+1] = _mm_unpackhi_epi8(a[k], a[k+4]);
+            }
+            for (k = 0; k < 8; k++) a[k] = t[k];
+        }
+        for (k = 0; k < 8; k++) _mm_storeu_si128((__m128i *)(dst+(16*k)), a[k]);
+        dst = dst + 128;
+    }
+    if (n%16)
+    {
+        uchar *tail[8];
+        for (k = 0; k < 8; k++) tail[k] = planes[k]+(16*blocks);
+        lzGather8Scalar(dst, tail, n%16);
+    }
+}
+
+__attribute__((target("avx2")))
+static void lzStore2x128(uchar *lo, uchar *hi, __m256i v)
+{
+    _mm_storeu_si128((__m128i *)lo, _mm256_castsi256_si128(v));
+    _mm_storeu_si128((__m128i *)hi, _mm256_extracti128_si256(v, 1));
+}
+
+__attribute__((target("avx2")))
+static void lzGather4Avx2(uchar *dst, uchar **planes, ulong n)
+{
+    ulong i, blocks = n/32;
+    int k, r;
+    __m256i a[4], t[4];
+    for (i = 0; i < blocks; i++)
+    {
+        for (k = 0; k < 4; k++) a[k] = _mm256_loadu_si256((const __m256i *)(planes[k]+(32*i)));
+        for (r = 0; r < 2; r++)
+        {
+            for (k = 0; k < 2; k++)
+            {
+                t[2*k] = _mm256_unpacklo_epi8(a[k], a[k+2]);
+                t[(2*k)+1] = _mm256_unpackhi_epi8(a[k], a[k+2]);
+            }
+            for (k = 0; k < 4; k++) a[k] = t[k];
+        }
+        for (k = 0; k < 4; k++) lzStore2x128(dst+(16*k), dst+64+(16*k), a[k]);
+        dst = dst + 128;
+    }
+    if (n%32)
+    {
+        uchar *tail[4];
+        for (k = 0; k < 4; k++) tail[k] = planes[k]+(32*blocks);
+        lzGather4Sse2(dst, tail, n%32);
+    }
+}
+
+__attribute__((target("avx2")))
+static void lzGather8Avx2(uchar *dst, uchar **planes, ulong n)
+{
+    ulong i, blocks = n/32;
+    int k, r;
+    __m256i a[8], t[8];
+    for (i = 0; i < blocks; i++)
+    {
+        for (k = 0; k < 8; k++) a[k] = _mm256_loadu_si256((const __m256i *)(planes[k]+(32*i)));
+        for (r = 0; r < 3; r++)
+        {
+            for (k = 0; k < 4; k++)
+            {
+                t[2*k] = _mm256_unpacklo_epi8(a[k], a[k+4]);
+                t[(2*k)+1] = _mm256_unpackhi_epi8(a[k], a[k+4]);
+            }
+            for (k = 0; k < 8; k++) a[k] = t[k];
+        }
+        for (k = 0; k < 8; k++) lzStore2x128(dst+(16*k), dst+128+(16*k), a[k]);
+        dst = dst + 256;
+    }
+    if (n%32)
+    {
+        uchar *tail[8];
+        for (k = 0; k < 8; k++) tail[k] = planes[k]+(32*blocks);
+        lzGather8Sse2(dst, tail, n%32);
+    }
+}
+
+__attribute__((target("avx2")))
+static void lzUnpack4Avx2(uchar *dst, const uchar *src, ulong nbBytes, const uchar *dict)
+{ // 16 packed bytes hold 32 nibbles, split, put back in order and looked up with pshufb
+    ulong i, blocks = nbBytes/16;
+    __m128i d = _mm_loadu_si128((const __m128i *)dict), m = _mm_set1_epi8(0x0F), v, lo, hi;
+    for (i = 0; i < blocks; i++)
+    {
+        v = _mm_loadu_si128((const __m128i *)(src+(16*i)));
+        lo = _mm_and_si128(v, m);
+        hi = _mm_and_si128(_mm_srli_epi16(v, 4), m);
+        _mm_storeu_si128((__m128i *)(dst+(32*i)), _mm_shuffle_epi8(d, _mm_unpacklo_epi8(lo, hi)));
+        _mm_storeu_si128((__m128i *)(dst+(32*i)+16), _mm_shuffle_epi8(d, _mm_unpackhi_epi8(lo, hi)));
+    }
+    if (nbBytes%16) lzUnpackTable(dst+(32*blocks), src+(16*blocks), nbBytes%16, 4, dict);
+}
+
+/*
+ * Prefix scans. A register is scanned with shifted copies of itself, then
+ * the last element of the previous register (both, for a stride of 2) is
+ * broadcast and combined in, so one dependency per register is left.
+ */
+
+__attribute__((target("sse2")))
+static void lzPrefix4Sse2(uchar *buf, ulong n, int stride, int add)
+{
+    ulong i, blocks = n/4;
+    __m128i x, carry = _mm_setzero_si128();
+    for (i = 0; i < blocks; i++)
+    {
+        x = _mm_loadu_si128((const __m128i *)(buf+(16*i)));
+        if (add)
+        {
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi32(x, carry);
+            carry = _mm_shuffle_epi32(x, 0xFF);
+        } else if (stride == 1) {
+            x = _mm_xor_si128(x, _mm_slli_si128(x, 4));
+            x = _mm_xor_si128(x, _mm_slli_si128(x, 8));
+            x = _mm_xor_si128(x, carry);
+            carry = _mm_shuffle_epi32(x, 0xFF);
+        } else {
+            x = _mm_xor_si128(x, _mm_slli_si128(x, 8));
+            x = _mm_xor_si128(x, carry);
+            carry = _mm_unpackhi_epi64(x, x);
+        }
+        _mm_storeu_si128((__m128i *)(buf+(16*i)), x);
+    }
+    if ((n%4) && (blocks > 0)) lzPrefixScalar(buf+(16*blocks)-(4*stride), (n%4)+stride, 4, stride, add);
+    else if (n%4) lzPrefixScalar(buf, n, 4, stride, add);
+}
+
+__attribute__((target("sse2")))
+static void lzPrefix8Sse2(uchar *buf, ulong n, int stride, int add)
+{
+    ulong i, blocks = n/2;
+    __m128i x, carry = _mm_setzero_si128();
+    for (i = 0; i < blocks; i++)
+    {
+        x = _mm_loadu_si128((const __m128i *)(buf+(16*i)));
+        if (add)
+        {
+            x = _mm_add_epi64(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi64(x, carry);
+            carry = _mm_unpackhi_epi64(x, x);
+        } else if (stride == 1) {
+            x = _mm_xor_si128(x, _mm_slli_si128(x, 8));
+            x = _mm_xor_si128(x, carry);
+            carry = _mm_unpackhi_epi64(x, x);
+        } else {
+            x = _mm_xor_si128(x, carry);
+            carry = x;
+        }
+        _mm_storeu_si128((__m128i *)(buf+(16*i)), x);
+    }
+    if ((n%2) && (blocks > 0)) lzPrefixScalar(buf+(16*blocks)-(8*stride), 1+stride, 8, stride, add);
+    else if (n%2) lzPrefixScalar(buf, n, 8, stride, add);
+}
+
+/*
+ * Quantization. The rounding half is added to the whole value, so a mantissa
+ * that overflows carries into the exponent as it should, and the result is
+ * masked. Lanes that were NaN or Inf, or that would round up to Inf, take the
+ * truncated value instead. Double lanes are compared on their high dword
+ * with SSE2, both dwords must match.
+ */
+
+__attribute__((target("sse2")))
+static void lzQuantize2Sse2(uchar *dst, const uchar *src, ulong n, ulong keep, ulong half)
+{ // Either half format, tested against the fp16 exponent (see lzQuantizeMasks)
+    ulong i, blocks = n/8;
+    __m128i x, r, s, e = _mm_set1_epi16(0x7C00), k = _mm_set1_epi16((short)keep), h = _mm_set1_epi16((short)half);
+    for (i = 0; i < blocks; i++)
+    {
+        x = _mm_loadu_si128((const __m128i *)(src+(16*i)));
+        r = _mm_and_si128(_mm_add_epi16(x, h), k);
+        s = _mm_or_si128(_mm_cmpeq_epi16(_mm_and_si128(x, e), e), _mm_cmpeq_epi16(_mm_and_si128(r, e), e));
+        r = _mm_or_si128(_mm_and_si128(s, _mm_and_si128(x, k)), _mm_andnot_si128(s, r));
+        _mm_storeu_si128((__m128i *)(dst+(16*i)), r);
+    }
+    lzQuantizeTail(dst+(16*blocks), src+(16*blocks), n%8, 2, keep, half);
+}
+
+__attribute__((target("sse2")))
+static void lzQuantize4Sse2(uchar *dst, const uchar *src, ulong n, ulong keep, ulong half)
+{
+    ulong i, blocks = n/4;
+    __m128i x, r, s, e = _mm_set1_epi32(0x7F800000), k = _mm_set1_epi32((int)keep), h = _mm_set1_epi32((int)half);
+    for (i = 0; i < blocks; i++)
+    {
+        x = _mm_loadu_si128((const __m128i *)(src+(16*i)));
+        r = _mm_and_si128(_mm_add_epi32(x, h), k);
+        s = _mm_or_si128(_mm_cmpeq_epi32(_mm_and_si128(x, e), e), _mm_cmpeq_epi32(_mm_and_si128(r, e), e));
+        r = _mm_or_si128(_mm_and_si128(s, _mm_and_si128(x, k)), _mm_andnot_si128(s, r));
+        _mm_storeu_si128((__m128i *)(dst+(16*i)), r);
+    }
+    lzQuantizeTail(dst+(16*blocks), src+(16*blocks), n%4, 4, keep, half);
+}
+
+__attribute__((target("sse2")))
+static __m128i lzExpOnes8Sse2(__m128i x, __m128i e)
+{
+    __m128i m = _mm_cmpeq_epi32(_mm_and_si128(x, e), e);
+    return _mm_and_si128(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+__attribute__((target("sse2")))
+static void lzQuantize8Sse2(uchar *dst, const uchar *src, ulong n, ulong keep, ulong half)
+{
+    ulong i, blocks = n/2;
+    __m128i x, r, s, e = _mm_set1_epi64x(0x7FF0000000000000L), k = _mm_set1_epi64x((long)keep), h = _mm_set1_epi64x((long)half);
+    for (i = 0; i < blocks; i++)
+    {
+        x = _mm_loadu_si128((const __m128i *)(src+(16*i)));
+        r = _mm_and_si128(_mm_add_epi64(x, h), k);
+        s = _mm_or_si128(lzExpOnes8Sse2(x, e), lzExpOnes8Sse2(r, e));
+        r = _mm_or_si128(_mm_and_si128(s, _mm_and_si128(x, k)), _mm_andnot_si128(s, r));
+        _mm_storeu_si128((__m128i *)(dst+(16*i)), r);
+    }
+    lzQuantizeTail(dst+(16*blocks), src+(16*blocks), n%2, 8, keep, half);
+}
+
+__attribute__((target("avx2")))
+static void lzQuantize2Avx2(uchar *dst, const uchar *src, ulong n, ulong keep, ulong half)
+{
+    ulong i, blocks = n/16;
+    __m256i x, r, s, e = _mm256_set1_epi16(0x7C00), k = _mm256_set1_epi16((short)keep), h = _mm256_set1_epi16((short)half);
+    for (i = 0; i < blocks; i++)
+    {
+        x = _mm256_loadu_si256((const __m256i *)(src+(32*i)));
+        r = _mm256_and_si256(_mm256_add_epi16(x, h), k);
+        s = _mm256_or_si256(_mm256_cmpeq_epi16(_mm256_and_si256(x, e), e), _mm256_cmpeq_epi16(_mm256_and_si256(r, e), e));
+        r = _mm256_blendv_epi8(r, _mm256_and_si256(x, k), s);
+        _mm256_storeu_si256((__m256i *)(dst+(32*i)), r);
+    }
+    lzQuantizeTail(dst+(32*blocks), src+(32*blocks), n%16, 2, keep, half);
+}
+
+__attribute__((target("avx2")))
+static void lzQuantize4Avx2(uchar *dst, const uchar *src, ulong n, ulong keep, ulong half)
+{
+    ulong i, blocks = n/8;
+    __m256i x, r, s, e = _mm256_set1_epi32(0x7F800000), k = _mm256_set1_epi32((int)keep), h = _mm256_set1_epi32((int)half);
+    for (i = 0; i < blocks; i++)
+    {
+        x = _mm256_loadu_si256((const __m256i *)(src+(32*i)));
+        r = _mm256_and_si256(_mm256_add_epi32(x, h), k);
+        s = _mm256_or_si256(_mm256_cmpeq_epi32(_mm256_and_si256(x, e), e), _mm256_cmpeq_epi32(_mm256_and_si256(r, e), e));
+        r = _mm256_blendv_epi8(r, _mm256_and_si256(x, k), s);
+        _mm256_storeu_si256((__m256i *)(dst+(32*i)), r);
+    }
+    lzQuantizeTail(dst+(32*blocks), src+(32*blocks), n%8, 4, keep, half);
+}
+
+__attribute__((target("avx2")))
+static void lzQuantize8Avx2(uchar *dst, const uchar *src, ulong n, ulong keep, ulong half)
+{
+    ulong i, blocks = n/4;
+    __m256i x, r, s, e = _mm256_set1_epi64x(0x7FF0000000000000L), k = _mm256_set1_epi64x((long)keep), h = _mm256_set1_epi64x((long)half);
+    for (i = 0; i < blocks; i++)
+    {
+        x = _mm256_loadu_si256((const __m256i *)(src+(32*i)));
+        r = _mm256_and_si256(_mm256_add_epi64(x, h), k);
+        s = _mm256_or_si256(_mm256_cmpeq_epi64(_mm256_and_si256(x, e), e), _mm256_cmpeq_epi64(_mm256_and_si256(r, e), e));
+        r = _mm256_blendv_epi8(r, _mm256_and_si256(x, k), s);
+        _mm256_storeu_si256((__m256i *)(dst+(32*i)), r);
+    }
+    lzQuantizeTail(dst+(32*blocks), src+(32*blocks), n%4, 8, keep, half);
+}
+
+/*
+ * F16C converts 8 floats to fp16 and back in one instruction. bf16 has no
+ * instruction below AVX-512, its rounding is done on the integer lanes and
+ * the words are packed, packus works per 128-bit lane so a permute restores
+ * the order. The widening loops run down from the last block as the scalar
+ * ones do.
+ */
+
+__attribute__((target("avx,f16c")))
+static void lzFloatToHalfF16c(ushort *dst, const float *src, ulong n)
+{
+    ulong i, blocks = n/8;
+    for (i = 0; i < blocks; i++) _mm_storeu_si128((__m128i *)(dst+(8*i)), _mm256_cvtps_ph(_mm256_loadu_ps(src+(8*i)), _MM_FROUND_TO_NEAREST_INT));
+    lzFloatToHalfScalar(dst+(8*blocks), src+(8*blocks), n%8);
+}
+
+__attribute__((target("avx,f16c")))
+static void lzHalfToFloatF16c(float *dst, const ushort *src, ulong n)
+{
+    ulong i, blocks = n/8;
+    lzHalfToFloatScalar(dst+(8*blocks), src+(8*blocks), n%8);
+    for (i = blocks; i > 0; i--) _mm256_storeu_ps(dst+(8*(i-1)), _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src+(8*(i-1))))));
+}
+
+__attribute__((target("avx2")))
+static __m256i lzBFloatOfAvx2(__m256i x)
+{
+    __m256i one = _mm256_set1_epi32(1), r, q, nan;
+    nan = _mm256_cmpgt_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0x7FFFFFFF)), _mm256_set1_epi32(0x7F800000));
+    r = _mm256_add_epi32(_mm256_set1_epi32(0x7FFF), _mm256_and_si256(_mm256_srli_epi32(x, 16), one));
+    r = _mm256_srli_epi32(_mm256_add_epi32(x, r), 16);
+    q = _mm256_or_si256(_mm256_srli_epi32(x, 16), _mm256_set1_epi32(0x40));
+    return _mm256_blendv_epi8(r, q, nan);
+}
+
+__attribute__((target("avx2")))
+static void lzFloatToBFloatAvx2(ushort *dst, const float *src, ulong n)
+{
+    ulong i, blocks = n/16;
+    __m256i a, b;
+    for (i = 0; i < blocks; i++)
+    {
+        a = lzBFloatOfAvx2(_mm256_loadu_si256((const __m256i *)(src+(16*i))));
+        b = lzBFloatOfAvx2(_mm256_loadu_si256((const __m256i *)(src+(16*i)+8)));
+        _mm256_storeu_si256((__m256i *)(dst+(16*i)), _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    lzFloatToBFloatScalar(dst+(16*blocks), src+(16*blocks), n%16);
+}
+
+__attribute__((target("avx2")))
+static void lzBFloatToFloatAvx2(float *dst, const ushort *src, ulong n)
+{
+    ulong i, blocks = n/8;
+    lzBFloatToFloatScalar(dst+(8*blocks), src+(8*blocks), n%8);
+    for (i = blocks; i > 0; i--)
+    {
+        __m256i x = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src+(8*(i-1)))));
+        _mm256_storeu_si256((__m256i *)(dst+(8*(i-1))), _mm256_slli_epi32(x, 16));
+    }
+}
+
+/*
+ * The float check narrows and widens with cvtpd2ps/cvtps2pd and compares the
+ * bits as integers, an ordered compare would let -0 pass for +0 and refuse
+ * every NaN. Float subnormals are caught on the magnitude of the double, a
+ * NaN compares not-less and goes through on the bits alone.
+ */
+
+__attribute__((target("sse2")))
+static int lzFitsFloatSse2(const double *src, ulong n)
+{
+    ulong i, blocks = n/4;
+    __m128d a, b, abs = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFL)), min = _mm_set1_pd(FLT_MIN), zero = _mm_setzero_pd();
+    __m128i ok;
+    for (i = 0; i < blocks; i++)
+    {
+        a = _mm_loadu_pd(src+(4*i));
+        b = _mm_loadu_pd(src+(4*i)+2);
+        ok = _mm_and_si128(_mm_cmpeq_epi32(_mm_castpd_si128(a), _mm_castpd_si128(_mm_cvtps_pd(_mm_cvtpd_ps(a)))),
+                           _mm_cmpeq_epi32(_mm_castpd_si128(b), _mm_castpd_si128(_mm_cvtps_pd(_mm_cvtpd_ps(b)))));
+        ok = _mm_and_si128(ok, _mm_castpd_si128(_mm_or_pd(_mm_cmpnlt_pd(_mm_and_pd(a, abs), min), _mm_cmpeq_pd(a, zero))));
+        ok = _mm_and_si128(ok, _mm_castpd_si128(_mm_or_pd(_mm_cmpnlt_pd(_mm_and_pd(b, abs), min), _mm_cmpeq_pd(b, zero))));
+        if (_mm_movemask_epi8(ok) != 0xFFFF) return 0;
+    }
+    return lzFitsFloatScalar(src+(4*blocks), n%4);
+}
+
+__attribute__((target("sse2")))
+static void lzDoubleToFloatSse2(float *dst, const double *src, ulong n)
+{
+    ulong i, blocks = n/4;
+    for (i = 0; i < blocks; i++) _mm_storeu_ps(dst+(4*i), _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(src+(4*i))), _mm_cvtpd_ps(_mm_loadu_pd(src+(4*i)+2))));
+    lzDoubleToFloatScalar(dst+(4*blocks), src+(4*blocks), n%4);
+}
+
+__attribute__((target("sse2")))
+static void lzFloatToDoubleSse2(double *dst, const float *src, ulong n)
+{
+    ulong i, blocks = n/4;
+    __m128 x;
+    lzFloatToDoubleScalar(dst+(4*blocks), src+(4*blocks), n%4);
+    for (i = blocks; i > 0; i--)
+    {
+        x = _mm_loadu_ps(src+(4*(i-1)));
+        _mm_storeu_pd(dst+(4*(i-1))+2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+        _mm_storeu_pd(dst+(4*(i-1)), _mm_cvtps_pd(x));
+    }
+}
+
+__attribute__((target("avx2")))
+static int lzFitsFloatAvx2(const double *src, ulong n)
+{
+    ulong i, blocks = n/8;
+    __m256d a, b, abs = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFL)), min = _mm256_set1_pd(FLT_MIN), zero = _mm256_setzero_pd();
+    __m256i ok;
+    for (i = 0; i < blocks; i++)
+    {
+        a = _mm256_loadu_pd(src+(8*i));
+        b = _mm256_loadu_pd(src+(8*i)+4);
+        ok = _mm256_and_si256(_mm256_cmpeq_epi64(_mm256_castpd_si256(a), _mm256_castpd_si256(_mm256_cvtps_pd(_mm256_cvtpd_ps(a)))),
+                              _mm256_cmpeq_epi64(_mm256_castpd_si256(b), _mm256_castpd_si256(_mm256_cvtps_pd(_mm256_cvtpd_ps(b)))));
+        ok = _mm256_and_si256(ok, _mm256_castpd_si256(_mm256_or_pd(_mm256_cmp_pd(_mm256_and_pd(a, abs), min, _CMP_NLT_UQ), _mm256_cmp_pd(a, zero, _CMP_EQ_OQ))));
+        ok = _mm256_and_si256(ok, _mm256_castpd_si256(_mm256_or_pd(_mm256_cmp_pd(_mm256_and_pd(b, abs), min, _CMP_NLT_UQ), _mm256_cmp_pd(b, zero, _CMP_EQ_OQ))));
+        if (_mm256_movemask_epi8(ok) != -1) return 0;
+    }
+    return lzFitsFloatScalar(src+(8*blocks), n%8);
+}
+
+__attribute__((target("avx2")))
+static void lzDoubleToFloatAvx2(float *dst, const double *src, ulong n)
+{
+    ulong i, blocks = n/8;
+    for (i = 0; i < blocks; i++)
+    {
+        _mm_storeu_ps(dst+(8*i), _mm256_cvtpd_ps(_mm256_loadu_pd(src+(8*i))));
+        _mm_storeu_ps(dst+(8*i)+4, _mm256_cvtpd_ps(_mm256_loadu_pd(src+(8*i)+4)));
+    }
+    lzDoubleToFloatScalar(dst+(8*blocks), src+(8*blocks), n%8);
+}
+
+__attribute__((target("avx2")))
+static void lzFloatToDoubleAvx2(double *dst, const float *src, ulong n)
+{
+    ulong i, blocks = n/8;
+    __m256 x;
+    lzFloatToDoubleScalar(dst+(8*blocks), src+(8*blocks), n%8);
+    for (i = blocks; i > 0; i--)
+    {
+        x = _mm256_loadu_ps(src+(8*(i-1)));
+        _mm256_storeu_pd(dst+(8*(i-1))+4, _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+        _mm256_storeu_pd(dst+(8*(i-1)), _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+    }
+}
+
+#endif
+
+
+#if LZ_BMI2
+
+/*
+ * Bit packing. With the kept bits of every byte in the mask, PEXT of a word
+ * of 8 elements is exactly their packed group and PDEP puts a group back.
+ * Groups move with full 64-bit loads and stores while those stay within the
+ * avail bytes of the packed side, the last ones go through the scalar tail.
+ * PEXT and PDEP are microcoded on AMD before Zen 3, lzSelectIsa keeps the
+ * scalar kernels there.
+ */
+
+static ulong lzBitsMask(int bits)
+{
+    return 0x0101010101010101UL*((0xFF << (8-bits)) & 0xFF);
+}
+
+__attribute__((target("bmi2")))
+static void lzPackGroupsBmi2(uchar *dst, const uchar *src, ulong groups, ulong avail, int bits)
+{ // dst may be src
+    ulong g, w, mask = lzBitsMask(bits);
+    for (g = 0; g < groups; g++)
+    {
+        if ((g*bits)+8 > avail)
+        {
+            lzPackGroupsScalar(dst+(g*bits), src+(8*g), groups-g, 0, bits);
+            return;
+        }
+        memcpy(&w, src+(8*g), 8);
+        w = _pext_u64(w, mask);
+        memcpy(dst+(g*bits), &w, 8);
+    }
+}
+
+__attribute__((target("bmi2")))
+static void lzUnpackGroupsBmi2(uchar *dst, const uchar *src, ulong groups, ulong avail, int bits)
+{ // The group is loaded before it is stored, so src may end where dst ends
+    ulong g, w, mask = lzBitsMask(bits);
+    for (g = 0; g < groups; g++)
+    {
+        if ((g*bits)+8 > avail)
+        {
+            lzUnpackGroupsScalar(dst+(8*g), src+(g*bits), groups-g, 0, bits);
+            return;
+        }
+        memcpy(&w, src+(g*bits), 8);
+        w = _pdep_u64(w, mask);
+        memcpy(dst+(8*g), &w, 8);
+    }
+}
+
+#endif
+
+
+int lzSupportedIsa(void)
+{
+#if LZ_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return LZ_ISA_AVX2;
+    if (__builtin_cpu_supports("sse2")) return LZ_ISA_SSE2;
+#endif
+    return LZ_ISA_SCALAR;
+}
+
+
+static void lzSetIsa(int isa)
+{ // Fills the dispatch table, only ever run by pthread_once or an explicit lzSelectIsa
+    int max = lzSupportedIsa();
+    if ((isa < 0) || (isa > max)) isa = max;
+    lzSplit2 = lzSplit2Scalar;
+    lzSplit4 = lzSplit4Scalar;
+    lzSplit8 = lzSplit8Scalar;
+    lzGather2 = lzGather2Scalar;
+    lzGather4 = lzGather4Scalar;
+    lzGather8 = lzGather8Scalar;
+    lzUnpack4 = lzUnpack4Scalar;
+    lzPackGroups = lzPackGroupsScalar;
+    lzUnpackGroups = lzUnpackGroupsScalar;
+    lzToHalf = lzFloatToHalfScalar;
+    lzFromHalf = lzHalfToFloatScalar;
+    lzToBFloat = lzFloatToBFloatScalar;
+    lzFromBFloat = lzBFloatToFloatScalar;
+    lzToFloat = lzDoubleToFloatScalar;
+    lzToDouble = lzFloatToDoubleScalar;
+    lzFits = lzFitsFloatScalar;
+#if LZ_X86
+    if (isa >= LZ_ISA_SSE2)
+    {
+        lzSplit2 = lzSplit2Sse2;
+        lzGather2 = lzGather2Sse2;
+        lzSplit4 = lzSplit4Sse2;
+        lzSplit8 = lzSplit8Sse2;
+        lzGather4 = lzGather4Sse2;
+        lzGather8 = lzGather8Sse2;
+        lzToFloat = lzDoubleToFloatSse2;
+        lzToDouble = lzFloatToDoubleSse2;
+        lzFits = lzFitsFloatSse2;
+    }
+    if (isa >= LZ_ISA_AVX2)
+    {
+        lzSplit4 = lzSplit4Avx2;
+        lzSplit8 = lzSplit8Avx2;
+        lzGather4 = lzGather4Avx2;
+        lzGather8 = lzGather8Avx2;
+        lzUnpack4 = lzUnpack4Avx2;
+        lzToBFloat = lzFloatToBFloatAvx2;
+        lzFromBFloat = lzBFloatToFloatAvx2;
+        lzToFloat = lzDoubleToFloatAvx2;
+        lzToDouble = lzFloatToDoubleAvx2;
+        lzFits = lzFitsFloatAvx2;
+    }
+    if ((isa >= LZ_ISA_AVX2) && __builtin_cpu_supports("f16c"))
+    {
+        lzToHalf = lzFloatToHalfF16c;
+        lzFromHalf = lzHalfToFloatF16c;
+    }
+#endif
+#if LZ_BMI2
+    if ((isa >= LZ_ISA_AVX2) && __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2"))
+    {
+        lzPackGroups = lzPackGroupsBmi2;
+        lzUnpackGroups = lzUnpackGroupsBmi2;
+    }
+#endif
+    lzIsa = isa;
+    if (VERBOSE) printf("Kernel ISA : %d \n", lzIsa);
+}
+
+
+static void lzInitIsa(void)
+{
+    lzSetIsa(-1);
+}
+
+
+int lzSelectIsa(int isa)
+{ // The best ISA is set up once on first use, by whichever thread gets there; an explicit choice must not run alongside other calls
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    lzSetIsa(isa);
+    return lzIsa;
+}
+
+
+int lzSplitPlanes(uchar **planes, const uchar *src, ulong n, ushort prec)
+{
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    switch (prec)
+    {
+        case 2: lzSplit2(planes, src, n); break;
+        case 4: lzSplit4(planes, src, n); break;
+        case 8: lzSplit8(planes, src, n); break;
+        default: lzSplitScalar(planes, src, n, prec);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int lzGatherPlanes(uchar *dst, uchar **planes, ulong n, ushort prec)
+{
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    switch (prec)
+    {
+        case 2: lzGather2(dst, planes, n); break;
+        case 4: lzGather4(dst, planes, n); break;
+        case 8: lzGather8(dst, planes, n); break;
+        default: lzGatherScalar(dst, planes, n, prec);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int lzUnpackPlane(uchar *dst, const uchar *src, ulong first, ulong n, int bits, const uchar *dict)
+{ // Elements [first, first+n) of a plane packed with bits bits per index, dict has 16 entries
+    ulong head, body, per;
+    if ((bits != 1) && (bits != 2) && (bits != 4)) return EXIT_FAILURE;
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    per = 8/bits;
+    head = (per-(first%per))%per;
+    if (head > n) head = n;
+    lzUnpackScalar(dst, src, first, head, bits, dict);
+    src = src+((first+head)/per);
+    dst = dst+head;
+    n = n-head;
+    body = n/per;
+    if (bits == 4) lzUnpack4(dst, src, body, dict);
+    else lzUnpackTable(dst, src, body, bits, dict);
+    lzUnpackScalar(dst+(body*per), src+body, 0, n%per, bits, dict);
+    return EXIT_SUCCESS;
+}
+
+
+int lzPackBits(uchar *dst, const uchar *src, ulong n, int bits)
+{ // The high bits bits of n bytes into ((n*bits)+7)/8 bytes, dst may be src
+    if ((bits < 1) || (bits > 7)) return EXIT_FAILURE;
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    lzPackGroups(dst, src, n/8, ((n*bits)+7)/8, bits);
+    lzPackTail(dst+((n/8)*bits), src+(8*(n/8)), n%8, bits);
+    return EXIT_SUCCESS;
+}
+
+
+int lzUnpackBits(uchar *dst, const uchar *src, ulong first, ulong n, int bits)
+{ // Elements [first, first+n) of lzPackBits output, from first 0 src may also end where dst+n ends
+    ulong head, body, avail;
+    if ((bits < 1) || (bits > 7)) return EXIT_FAILURE;
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    head = (8-(first%8))%8;
+    if (head > n) head = n;
+    lzUnpackBitsScalar(dst, src, first, head, bits);
+    src = src+(((first+head)/8)*bits);
+    dst = dst+head;
+    n = n-head;
+    body = n/8;
+    avail = ((n*bits)+7)/8;
+    lzUnpackGroups(dst, src, body, avail, bits);
+    lzUnpackTail(dst+(8*body), src+(body*bits), n%8, bits);
+    return EXIT_SUCCESS;
+}
+
+
+int lzPrefixXor(uchar *buf, ulong n, ushort prec, int stride)
+{
+    if ((stride != 1) && (stride != 2)) return EXIT_FAILURE;
+    pthread_once(&lzIsaOnce, lzInitIsa);
+#if LZ_X86
+    if ((lzIsa >= LZ_ISA_SSE2) && (prec == 4)) lzPrefix4Sse2(buf, n, stride, 0);
+    else if ((lzIsa >= LZ_ISA_SSE2) && (prec == 8)) lzPrefix8Sse2(buf, n, stride, 0);
+    else lzPrefixScalar(buf, n, prec, stride, 0);
+#else
+    lzPrefixScalar(buf, n, prec, stride, 0);
+#endif
+    return EXIT_SUCCESS;
+}
+
+
+int lzPrefixAdd(uchar *buf, ulong n, ushort prec)
+{
+    pthread_once(&lzIsaOnce, lzInitIsa);
+#if LZ_X86
+    if ((lzIsa >= LZ_ISA_SSE2) && (prec == 4)) lzPrefix4Sse2(buf, n, 1, 1);
+    else if ((lzIsa >= LZ_ISA_SSE2) && (prec == 8)) lzPrefix8Sse2(buf, n, 1, 1);
+    else lzPrefixScalar(buf, n, prec, 1, 1);
+#else
+    lzPrefixScalar(buf, n, prec, 1, 1);
+#endif
+    return EXIT_SUCCESS;
+}
+
+
+int lzQuantize(uchar *dst, const uchar *src, ulong n, ushort prec, short lossy, int round)
+{ // dst may be src
+    ulong keep, half;
+    if ((prec != 2) && (prec != 4) && (prec != 8)) return EXIT_FAILURE;
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    lzQuantizeMasks(prec, lossy, round, &keep, &half);
+#if LZ_X86
+    if ((lzIsa >= LZ_ISA_AVX2) && (prec == 2)) lzQuantize2Avx2(dst, src, n, keep, half);
+    else if ((lzIsa >= LZ_ISA_AVX2) && (prec == 4)) lzQuantize4Avx2(dst, src, n, keep, half);
+    else if ((lzIsa >= LZ_ISA_AVX2) && (prec == 8)) lzQuantize8Avx2(dst, src, n, keep, half);
+    else if ((lzIsa >= LZ_ISA_SSE2) && (prec == 2)) lzQuantize2Sse2(dst, src, n, keep, half);
+    else if ((lzIsa >= LZ_ISA_SSE2) && (prec == 4)) lzQuantize4Sse2(dst, src, n, keep, half);
+    else if ((lzIsa >= LZ_ISA_SSE2) && (prec == 8)) lzQuantize8Sse2(dst, src, n, keep, half);
+    else lzQuantizeTail(dst, src, n, prec, keep, half);
+#else
+    lzQuantizeTail(dst, src, n, prec, keep, half);
+#endif
+    return EXIT_SUCCESS;
+}
+
+
+int lzFloatToHalf(ushort *dst, const float *src, ulong n)
+{ // dst may be src seen as halves
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    lzToHalf(dst, src, n);
+    return EXIT_SUCCESS;
+}
+
+
+int lzHalfToFloat(float *dst, const ushort *src, ulong n)
+{ // The halves may be the start of dst
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    lzFromHalf(dst, src, n);
+    return EXIT_SUCCESS;
+}
+
+
+int lzFloatToBFloat(ushort *dst, const float *src, ulong n)
+{
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    lzToBFloat(dst, src, n);
+    return EXIT_SUCCESS;
+}
+
+
+int lzBFloatToFloat(float *dst, const ushort *src, ulong n)
+{
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    lzFromBFloat(dst, src, n);
+    return EXIT_SUCCESS;
+}
+
+
+int lzFitsFloat(const double *src, ulong n)
+{ // 1 when every element is a float, normal or zero, stored as a double
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    return lzFits(src, n);
+}
+
+
+int lzDoubleToFloat(float *dst, const double *src, ulong n)
+{ // Exact for the arrays lzFitsFloat accepts, dst may be the start of src
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    lzToFloat(dst, src, n);
+    return EXIT_SUCCESS;
+}
+
+
+int lzFloatToDouble(double *dst, const float *src, ulong n)
+{ // The floats may be the start of dst
+    pthread_once(&lzIsaOnce, lzInitIsa);
+    lzToDouble(dst, src, n);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Byte histogram. Consecutive bytes go to four different tables, so the
+ * increments of a run of equal bytes do not wait on each other, and the
+ * input is read one 64-bit word at a time. The tables are summed at the end.
+ * It is scalar for every ISA: SSE2 and AVX2 have no scatter, and counting
+ * lanes with gathers and compares loses to the tables on the few KB that
+ * entropyAnalysis samples, so it is not behind the dispatch table.
+ */
+
+void lzHistogram(unsigned int count[256], const uchar *buf, ulong n)
+{
+    unsigned int table[4][256];
+    ulong i, word;
+    int k;
+    memset(table, 0, sizeof(table));
+    for (i = 0; i+8 <= n; i = i+8)
+    {
+        memcpy(&word, buf+i, 8);
+        table[0][word & 0xFF]++;
+        table[1][(word >> 8) & 0xFF]++;
+        table[2][(word >> 16) & 0xFF]++;
+        table[3][(word >> 24) & 0xFF]++;
+        table[0][(word >> 32) & 0xFF]++;
+        table[1][(word >> 40) & 0xFF]++;
+        table[2][(word >> 48) & 0xFF]++;
+        table[3][word >> 56]++;
+    }
+    for (; i < n; i++) table[i%4][buf[i]]++;
+    for (k = 0; k < 256; k++) count[k] = table[0][k]+table[1][k]+table[2][k]+table[3][k];
+}
@@ -0,0 +1,306 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  lzstream.c
+ *
+ *    Description:  Streaming interface of the lz floating point compression library
+ *
+ *        Version:  1.0
+ *        Created:  10/18/2026 02:00:00 PM CDT
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Leonardo A. Bautista Gomez (leobago@anl.gov),
+ *        Company:  Argonne National Laboratory
+ *
+ * =====================================================================================
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#define MINIZ_HEADER_FILE_ONLY
+#include "miniz.c"
+#include "lz.h"
+
+
+/*
+ * Streamed layout: the elements are fed in any number of calls, gathered in
+ * tiles of TILE_SIZE bytes and every tile is split into planes that go to one
+ * deflate stream per plane. The streams stay open for the whole array and are
+ * only sync-flushed at the end of a tile, so the working memory is fixed and
+ * the compression ratio is close to the one of the whole array.
+ *
+ *   ushort prec, short lossy, ulong tileEle, int code[prec]
+ *   per tile: ulong nbEle, int last, ulong size[prec], plane data
+ */
+
+static int lzStreamWrite(lzStream *strm, const uchar *buf, ulong size)
+{
+    if (strm->status != EXIT_SUCCESS) return EXIT_FAILURE;
+    if ((size > 0) && (strm->write(strm->user, buf, size) != EXIT_SUCCESS)) strm->status = EXIT_FAILURE;
+    return strm->status;
+}
+
+
+static int lzStreamTile(lzStream *strm, int last)
+{ // Flush the current tile of every plane and write it
+    uchar head[sizeof(ulong)+sizeof(int)+(8*sizeof(ulong))];
+    ulong i, headSize, parSize[8];
+    size_t inLen, outLen;
+    tdefl_status status;
+    for (i = 0; i < strm->prec; i++)
+    {
+        parSize[i] = 0;
+        if (strm->code[i] == 0) parSize[i] = strm->fill;
+        if (strm->code[i] <= 0) continue;
+        inLen = strm->fill;
+        outLen = strm->outSize;
+        status = tdefl_compress((tdefl_compressor *)strm->comp[i], strm->planes[i], &inLen, strm->outBuf[i], &outLen,
+                last ? TDEFL_FINISH : TDEFL_SYNC_FLUSH);
+        if ((status != (last ? TDEFL_STATUS_DONE : TDEFL_STATUS_OKAY)) || (inLen != strm->fill) || (outLen >= strm->outSize))
+        { // The bound of outBuf leaves room for the flush markers, a full buffer means a broken stream
+            strm->status = EXIT_FAILURE;
+            return EXIT_FAILURE;
+        }
+        parSize[i] = outLen;
+    }
+    memcpy(head, &(strm->fill), sizeof(ulong));
+    headSize = sizeof(ulong);
+    memcpy(head+headSize, &last, sizeof(int));
+    headSize = headSize + sizeof(int);
+    memcpy(head+headSize, parSize, strm->prec*sizeof(ulong));
+    headSize = headSize + (strm->prec*sizeof(ulong));
+    lzStreamWrite(strm, head, headSize);
+    for (i = 0; i < strm->prec; i++)
+    {
+        if (strm->code[i] > 0) lzStreamWrite(strm, strm->outBuf[i], parSize[i]);
+        if (strm->code[i] == 0) lzStreamWrite(strm, strm->planes[i], parSize[i]);
+    }
+    strm->fill = 0;
+    return strm->status;
+}
+
+
+static void lzStreamFree(lzStream *strm)
+{
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        free(strm->comp[i]);
+        free(strm->planes[i]);
+        free(strm->outBuf[i]);
+    }
+    free(strm);
+}
+
+
+lzStream *lzStreamInit(ushort prec, short level, short protect, lzWriteFunc write, void *user)
+{
+    uchar head[sizeof(ushort)+sizeof(short)+sizeof(ulong)+(8*sizeof(int))];
+    ulong headSize;
+    int i, res = EXIT_SUCCESS;
+    mz_uint flags;
+    lzStream *strm;
+    short lossy = (prec*8)-protect;
+
+    if ((prec != 4) && (prec != 8)) return NULL;
+    if ((level < 1) || (level > MAX_LEVEL)) return NULL;
+    if ((lossy < 0) || (lossy > (prec*8)) || (write == NULL)) return NULL;
+    strm = calloc(1, sizeof(lzStream));
+    if (strm == NULL) return NULL;
+    strm->tileEle = TILE_SIZE/prec;
+    strm->outSize = mz_compressBound(strm->tileEle);
+    strm->write = write;
+    strm->user = user;
+    strm->prec = prec;
+    strm->level = level;
+    strm->lossy = lossy;
+    getCode(strm->code, prec, lossy);
+    flags = TDEFL_COMPUTE_ADLER32 | tdefl_create_comp_flags_from_zip_params(level, MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+    for (i = 0; i < prec; i++)
+    {
+        strm->planes[i] = malloc(strm->tileEle);
+        if (strm->planes[i] == NULL) res = EXIT_FAILURE;
+        if (strm->code[i] <= 0) continue;
+        strm->comp[i] = malloc(sizeof(tdefl_compressor));
+        strm->outBuf[i] = malloc(strm->outSize);
+        if ((strm->comp[i] == NULL) || (strm->outBuf[i] == NULL)) res = EXIT_FAILURE;
+        else if (tdefl_init((tdefl_compressor *)strm->comp[i], NULL, NULL, flags) != TDEFL_STATUS_OKAY) res = EXIT_FAILURE;
+    }
+    if (res == EXIT_SUCCESS)
+    {
+        memcpy(head, &prec, sizeof(ushort));
+        headSize = sizeof(ushort);
+        memcpy(head+headSize, &lossy, sizeof(short));
+        headSize = headSize + sizeof(short);
+        memcpy(head+headSize, &(strm->tileEle), sizeof(ulong));
+        headSize = headSize + sizeof(ulong);
+        memcpy(head+headSize, strm->code, prec*sizeof(int));
+        headSize = headSize + (prec*sizeof(int));
+        res = lzStreamWrite(strm, head, headSize);
+    }
+    if (res != EXIT_SUCCESS)
+    {
+        lzStreamFree(strm);
+        return NULL;
+    }
+    return strm;
+}
+
+
+int lzStreamFeed(lzStream *strm, const void *daBuf, ulong nbEle)
+{ // Elements are quantized and split straight into the tile planes, no copy of the input is kept
+    const uchar *src = daBuf;
+    uchar *planes[8];
+    ulong i, nb;
+    while ((nbEle > 0) && (strm->status == EXIT_SUCCESS))
+    {
+        nb = strm->tileEle-strm->fill;
+        if (nb > nbEle) nb = nbEle;
+        for (i = 0; i < strm->prec; i++) planes[i] = strm->planes[i]+strm->fill;
+        lzSplitQuantized(planes, src, nb, strm->prec, strm->lossy, 0);
+        strm->fill = strm->fill + nb;
+        strm->nbEle = strm->nbEle + nb;
+        src = src + (nb*strm->prec);
+        nbEle = nbEle - nb;
+        if (strm->fill == strm->tileEle) lzStreamTile(strm, 0);
+    }
+    return strm->status;
+}
+
+
+int lzStreamFlush(lzStream *strm)
+{ // Everything fed so far can be decoded from what has been written
+    if ((strm->fill == 0) || (strm->status != EXIT_SUCCESS)) return strm->status;
+    return lzStreamTile(strm, 0);
+}
+
+
+int lzStreamEnd(lzStream *strm)
+{
+    int res;
+    if (strm == NULL) return EXIT_FAILURE;
+    if (strm->status == EXIT_SUCCESS) lzStreamTile(strm, 1);
+    res = strm->status;
+    lzStreamFree(strm);
+    return res;
+}
+
+
+static int lzStreamCheck(uchar *srcBuf, ulong inSize, ulong *darSize)
+{ // Walk the tile headers and count the elements, no data is touched
+    ushort prec;
+    ulong i, nbEle = 0, tileEle, finalSize, parSize[8];
+    int last = 0, code[8];
+    if (inSize < sizeof(ushort)+sizeof(short)+sizeof(ulong)) return EXIT_FAILURE;
+    memcpy(&prec, srcBuf, sizeof(ushort));
+    if ((prec != 4) && (prec != 8)) return EXIT_FAILURE;
+    finalSize = sizeof(ushort)+sizeof(short);
+    memcpy(&tileEle, srcBuf+finalSize, sizeof(ulong));
+    finalSize = finalSize + sizeof(ulong);
+    if (finalSize+(prec*sizeof(int)) > inSize) return EXIT_FAILURE;
+    memcpy(code, srcBuf+finalSize, prec*sizeof(int));
+    finalSize = finalSize + (prec*sizeof(int));
+    while (!last)
+    {
+        if (finalSize+sizeof(ulong)+sizeof(int)+(prec*sizeof(ulong)) > inSize) return EXIT_FAILURE;
+        memcpy(&nbEle, srcBuf+finalSize, sizeof(ulong));
+        if (nbEle > tileEle) return EXIT_FAILURE;
+        *darSize = *darSize + nbEle;
+        finalSize = finalSize + sizeof(ulong);
+        memcpy(&last, srcBuf+finalSize, sizeof(int));
+        finalSize = finalSize + sizeof(int);
+        memcpy(parSize, srcBuf+finalSize, prec*sizeof(ulong));
+        finalSize = finalSize + (prec*sizeof(ulong));
+        for (i = 0; i < prec; i++)
+        {
+            if ((code[i] == 0) && (parSize[i] != nbEle)) return EXIT_FAILURE;
+            if ((code[i] < 0) && (parSize[i] != 0)) return EXIT_FAILURE;
+            if (parSize[i] > inSize-finalSize) return EXIT_FAILURE;
+            finalSize = finalSize + parSize[i];
+        }
+    }
+    if (finalSize != inSize) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+
+ulong lzStreamLength(uchar *srcBuf, ulong inSize)
+{ // Number of elements of a streamed array, 0 if the stream is broken
+    ulong nbEle = 0;
+    if (lzStreamCheck(srcBuf, inSize, &nbEle) != EXIT_SUCCESS) return 0;
+    return nbEle;
+}
+
+
+int lzUncompressStream(uchar *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize, ushort prec)
+{ // Tile by tile, the working memory is one tile of planes plus one inflate window per plane
+    lzWindow win[8];
+    uchar *planes[8];
+    ushort srcPrec;
+    ulong i, nbEle, tileEle, finalSize, parSize[8];
+    int last = 0, res = EXIT_SUCCESS, code[8];
+
+    *darSize = 0;
+    if (lzStreamCheck(srcBuf, inSize, darSize) != EXIT_SUCCESS) return EXIT_FAILURE;
+    *darSize = 0;
+    memcpy(&srcPrec, srcBuf, sizeof(ushort));
+    if (srcPrec != prec) return EXIT_FAILURE;
+    finalSize = sizeof(ushort)+sizeof(short);
+    memcpy(&tileEle, srcBuf+finalSize, sizeof(ulong));
+    finalSize = finalSize + sizeof(ulong);
+    memcpy(code, srcBuf+finalSize, prec*sizeof(int));
+    finalSize = finalSize + (prec*sizeof(int));
+    memset(win, 0, sizeof(win));
+    memset(planes, 0, sizeof(planes));
+    for (i = 0; i < prec; i++)
+    {
+        planes[i] = malloc(tileEle);
+        if ((planes[i] == NULL) || (lzOpenWindow(win+i, NULL, 0) != EXIT_SUCCESS)) res = EXIT_FAILURE;
+    }
+    while ((!last) && (res == EXIT_SUCCESS))
+    {
+        memcpy(&nbEle, srcBuf+finalSize, sizeof(ulong));
+        finalSize = finalSize + sizeof(ulong);
+        memcpy(&last, srcBuf+finalSize, sizeof(int));
+        finalSize = finalSize + sizeof(int);
+        memcpy(parSize, srcBuf+finalSize, prec*sizeof(ulong));
+        finalSize = finalSize + (prec*sizeof(ulong));
+        for (i = 0; (i < prec) && (res == EXIT_SUCCESS); i++)
+        {
+            if (code[i] > 0)
+            { // The plane stream goes on from the previous tile
+                win[i].srcBuf = srcBuf+finalSize;
+                win[i].inSize = parSize[i];
+                if (lzInflateWindow(win+i, planes[i], nbEle, 1, last) != MZ_OK) res = EXIT_FAILURE;
+            } else {
+                if (code[i] == 0) memcpy(planes[i], srcBuf+finalSize, nbEle);
+                else memset(planes[i], 0, nbEle);
+            }
+            finalSize = finalSize + parSize[i];
+        }
+        if (res != EXIT_SUCCESS) break;
+        lzGatherPlanes(daBuf+((*darSize)*prec), planes, nbEle, prec);
+        *darSize = *darSize + nbEle;
+    }
+    for (i = 0; i < prec; i++)
+    {
+        free(planes[i]);
+        lzCloseWindow(win+i);
+    }
+    return res;
+}
+
+
+int lzUncompressFloatStream(float *darBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+{
+    return lzUncompressStream((uchar *)darBuf, darSize, srcBuf, inSize, sizeof(float));
+}
+
+
+int lzUncompressDoubleStream(double *daBuf, ulong *darSize, uchar *srcBuf, ulong inSize)
+{
+    return lzUncompressStream((uchar *)daBuf, darSize, srcBuf, inSize, sizeof(double));
+}
@@ -910,6 +910,11 @@ tdefl_status tdefl_compress_buffer(tdefl_compressor *d, const void *pIn_buf, siz
 tdefl_status tdefl_get_prev_return_status(tdefl_compressor *d);
 mz_uint32 tdefl_get_adler32(tdefl_compressor *d);
 
+// Primes the compressor with a preset dictionary (only its last TDEFL_LZ_DICT_SIZE bytes are used), matches may then reach back into it.
+// Must be called after tdefl_init() and before any data is compressed. The stream carries no trace of the dictionary:
+// it is decoded by tinfl_decompress() with a wrapping output buffer whose window already holds the same bytes before pOut_buf_next.
+tdefl_status tdefl_set_dictionary(tdefl_compressor *d, const void *pDict, size_t dict_size);
+
 // Can't use tdefl_create_comp_flags_from_zip_params if MINIZ_NO_ZLIB_APIS isn't defined, because it uses some of its macros.
 #ifndef MINIZ_NO_ZLIB_APIS
 // Create tdefl_compress() flags given zlib-style compression parameters.
@@ -2713,6 +2718,41 @@ tdefl_status tdefl_init(tdefl_compressor *d, tdefl_put_buf_func_ptr pPut_buf_fun
   return TDEFL_STATUS_OKAY;
 }
 
+tdefl_status tdefl_set_dictionary(tdefl_compressor *d, const void *pDict, size_t dict_size)
+{
+  const mz_uint8 *p = (const mz_uint8 *)pDict;
+  mz_uint i, n;
+  if ((d->m_lookahead_pos) || (d->m_lookahead_size) || (d->m_prev_return_status != TDEFL_STATUS_OKAY) || ((dict_size) && (!pDict)))
+    return (d->m_prev_return_status = TDEFL_STATUS_BAD_PARAM);
+  if (dict_size > TDEFL_LZ_DICT_SIZE) { p += dict_size - TDEFL_LZ_DICT_SIZE; dict_size = TDEFL_LZ_DICT_SIZE; }
+  n = (mz_uint)dict_size;
+  memcpy(d->m_dict, p, n);
+  memcpy(d->m_dict + TDEFL_LZ_DICT_SIZE, p, MZ_MIN(n, TDEFL_MAX_MATCH_LEN - 1));
+  // Hash the trigrams the way the parser that tdefl_compress() will pick does.
+#if MINIZ_USE_UNALIGNED_LOADS_AND_STORES && MINIZ_LITTLE_ENDIAN
+  if (((d->m_flags & TDEFL_MAX_PROBES_MASK) == 1) &&
+      ((d->m_flags & TDEFL_GREEDY_PARSING_FLAG) != 0) &&
+      ((d->m_flags & (TDEFL_FILTER_MATCHES | TDEFL_FORCE_ALL_RAW_BLOCKS | TDEFL_RLE_MATCHES)) == 0))
+  {
+    for (i = 0; i + 2 < n; i++)
+    {
+      mz_uint trigram = p[i] | (p[i + 1] << 8) | (p[i + 2] << 16);
+      d->m_hash[(trigram ^ (trigram >> (24 - (TDEFL_LZ_HASH_BITS - 8)))) & TDEFL_LEVEL1_HASH_SIZE_MASK] = (mz_uint16)i;
+    }
+  }
+  else
+#endif // #if MINIZ_USE_UNALIGNED_LOADS_AND_STORES && MINIZ_LITTLE_ENDIAN
+  {
+    for (i = 0; i + 2 < n; i++)
+    {
+      mz_uint hash = ((p[i] << (TDEFL_LZ_HASH_SHIFT * 2)) ^ (p[i + 1] << TDEFL_LZ_HASH_SHIFT) ^ p[i + 2]) & (TDEFL_LZ_HASH_SIZE - 1);
+      d->m_next[i & TDEFL_LZ_DICT_SIZE_MASK] = d->m_hash[hash]; d->m_hash[hash] = (mz_uint16)i;
+    }
+  }
+  d->m_lookahead_pos = d->m_dict_size = d->m_lz_code_buf_dict_pos = n;
+  return TDEFL_STATUS_OKAY;
+}
+
 tdefl_status tdefl_get_prev_return_status(tdefl_compressor *d)
 {
   return d->m_prev_return_status;
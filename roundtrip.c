@@ -0,0 +1,601 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  roundtrip.c
+ *
+ *    Description:  Round trips through every compression path of the lz library
+ *
+ *        Version:  1.0
+ *        Created:  10/18/2026 09:00:00 AM CDT
+ *       Revision:  none
+ *       Compiler:  gcc
+ *
+ *         Author:  Leonardo A. Bautista Gomez (leobago@anl.gov),
+ *        Company:  Argonne National Laboratory
+ *
+ * =====================================================================================
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lz.h"
+
+#define NB_ELE              300000
+#define NB_THREADS          4
+#define LEVEL               6
+#define ABS_ERR             1e-3
+
+typedef struct outStream
+{
+    uchar *buf;
+    ulong size;
+    ulong capacity;
+} outStream;
+
+static int nbTrips = 0;
+static int nbFails = 0;
+
+
+int report(const char *name, int res)
+{ // Counts one round trip, res is EXIT_SUCCESS when it came back as expected
+    nbTrips++;
+    if (res != EXIT_SUCCESS)
+    {
+        nbFails++;
+        printf("FAILED: %s\n", name);
+    }
+    return res;
+}
+
+
+int sameDoubles(const double *a, const double *b, ulong n, double absErr)
+{ // absErr 0 asks for the same bits
+    ulong i;
+    if (absErr == 0) return (memcmp(a, b, n*sizeof(double)) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    for (i = 0; i < n; i++) if (!(fabs(a[i]-b[i]) <= absErr)) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+
+int sameFloats(const float *a, const float *b, ulong n, double absErr)
+{
+    ulong i;
+    if (absErr == 0) return (memcmp(a, b, n*sizeof(float)) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    for (i = 0; i < n; i++) if (!(fabs(a[i]-b[i]) <= absErr)) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+
+void fillArrays(double *dBuf, float *fBuf, double *nBuf, ulong nbEle)
+{ // Random walks, nBuf holds doubles that all are floats so that narrowing applies
+    ulong i;
+    double point = 300.0;
+    srand(1);
+    for (i = 0; i < nbEle; i++)
+    {
+        point = point+(((rand()%1000)/1000.0)*((rand()%3)-1));
+        dBuf[i] = point+(sin(i*0.01)/7.0);
+        fBuf[i] = (float) dBuf[i];
+        nBuf[i] = fBuf[i];
+    }
+}
+
+
+int writeStream(void *user, const uchar *buf, ulong size)
+{ // lzWriteFunc appending to an outStream
+    outStream *out = user;
+    uchar *grown;
+    if (out->size+size > out->capacity)
+    {
+        grown = realloc(out->buf, 2*(out->size+size));
+        if (grown == NULL) return EXIT_FAILURE;
+        out->buf = grown;
+        out->capacity = 2*(out->size+size);
+    }
+    memcpy(out->buf+out->size, buf, size);
+    out->size = out->size + size;
+    return EXIT_SUCCESS;
+}
+
+
+int tripDouble(double *daBuf, ulong nbEle, short protect, double absErr)
+{ // Compressed and decompressed with the serial entry points
+    int res;
+    ulong outSize = lzCompressDoubleBound(nbEle, protect), darSize = nbEle;
+    uchar *dstBuf = malloc(outSize);
+    double *decBuf = malloc(nbEle*sizeof(double));
+    res = ((dstBuf == NULL) || (decBuf == NULL)) ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (res == EXIT_SUCCESS) res = lzCompressDouble(dstBuf, &outSize, daBuf, nbEle, LEVEL, protect);
+    if (res == EXIT_SUCCESS) res = lzUncompressDouble(decBuf, &darSize, dstBuf, outSize);
+    if ((res == EXIT_SUCCESS) && (darSize != nbEle)) res = EXIT_FAILURE;
+    if (res == EXIT_SUCCESS) res = sameDoubles(daBuf, decBuf, nbEle, absErr);
+    free(dstBuf);
+    free(decBuf);
+    return res;
+}
+
+
+int tripFloat(float *darBuf, ulong nbEle, short protect, double absErr)
+{
+    int res;
+    ulong outSize = lzCompressFloatBound(nbEle, protect), darSize = nbEle;
+    uchar *dstBuf = malloc(outSize);
+    float *decBuf = malloc(nbEle*sizeof(float));
+    res = ((dstBuf == NULL) || (decBuf == NULL)) ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (res == EXIT_SUCCESS) res = lzCompressFloat(dstBuf, &outSize, darBuf, nbEle, LEVEL, protect);
+    if (res == EXIT_SUCCESS) res = lzUncompressFloat(decBuf, &darSize, dstBuf, outSize);
+    if ((res == EXIT_SUCCESS) && (darSize != nbEle)) res = EXIT_FAILURE;
+    if (res == EXIT_SUCCESS) res = sameFloats(darBuf, decBuf, nbEle, absErr);
+    free(dstBuf);
+    free(decBuf);
+    return res;
+}
+
+
+int tripDoubleCtx(lzContext *ctx, double *daBuf, ulong nbEle, double absErr, int quant, int nbThreads)
+{ // Compressed with the settings of ctx, decompressed without a context, as a reader would
+    int res;
+    short protect = (absErr == 0) ? 64 : lzErrorProtect((uchar *)daBuf, nbEle, sizeof(double), absErr, quant);
+    ulong outSize = lzCompressDoubleBound(nbEle, protect), darSize = nbEle;
+    uchar *dstBuf = malloc(outSize);
+    double *decBuf = malloc(nbEle*sizeof(double));
+    res = ((dstBuf == NULL) || (decBuf == NULL)) ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (res == EXIT_SUCCESS) res = lzCompressDoubleCtxMT(ctx, dstBuf, &outSize, daBuf, nbEle, LEVEL, protect, nbThreads);
+    if (res == EXIT_SUCCESS) res = lzUncompressDoubleMT(decBuf, &darSize, dstBuf, outSize, nbThreads);
+    if ((res == EXIT_SUCCESS) && (darSize != nbEle)) res = EXIT_FAILURE;
+    if (res == EXIT_SUCCESS) res = sameDoubles(daBuf, decBuf, nbEle, absErr);
+    free(dstBuf);
+    free(decBuf);
+    return res;
+}
+
+
+int tripFloatCtx(lzContext *ctx, float *darBuf, ulong nbEle, double absErr, int quant, int nbThreads)
+{
+    int res;
+    short protect = (absErr == 0) ? 32 : lzErrorProtect((uchar *)darBuf, nbEle, sizeof(float), absErr, quant);
+    ulong outSize = lzCompressFloatBound(nbEle, protect), darSize = nbEle;
+    uchar *dstBuf = malloc(outSize);
+    float *decBuf = malloc(nbEle*sizeof(float));
+    res = ((dstBuf == NULL) || (decBuf == NULL)) ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (res == EXIT_SUCCESS) res = lzCompressFloatCtxMT(ctx, dstBuf, &outSize, darBuf, nbEle, LEVEL, protect, nbThreads);
+    if (res == EXIT_SUCCESS) res = lzUncompressFloatMT(decBuf, &darSize, dstBuf, outSize, nbThreads);
+    if ((res == EXIT_SUCCESS) && (darSize != nbEle)) res = EXIT_FAILURE;
+    if (res == EXIT_SUCCESS) res = sameFloats(darBuf, decBuf, nbEle, absErr);
+    free(dstBuf);
+    free(decBuf);
+    return res;
+}
+
+
+int testIsa(double *dBuf, float *fBuf, ulong nbEle)
+{ // Every kernel this CPU runs, lossless and with the low mantissa bits dropped
+    char name[128];
+    int isa;
+    for (isa = LZ_ISA_SCALAR; isa <= lzSupportedIsa(); isa++)
+    {
+        lzSelectIsa(isa);
+        sprintf(name, "double isa %d", isa);
+        report(name, tripDouble(dBuf, nbEle, 64, 0));
+        sprintf(name, "double isa %d lossy", isa);
+        report(name, tripDouble(dBuf, nbEle, 40, ABS_ERR));
+        sprintf(name, "float isa %d", isa);
+        report(name, tripFloat(fBuf, nbEle, 32, 0));
+        sprintf(name, "float isa %d lossy", isa);
+        report(name, tripFloat(fBuf, nbEle, 29, ABS_ERR));
+    }
+    lzSelectIsa(-1);
+    return EXIT_SUCCESS;
+}
+
+
+int testSelectors(double *dBuf, float *fBuf, double *nBuf, ulong nbEle)
+{ // Every predictor, quantizer and narrowing choice, alone and combined, lossless and lossy, on one and several threads
+    char name[128];
+    int pred, quant, narrow, lossy, threads;
+    double absErr;
+    lzContext *ctx;
+    for (pred = LZ_PRED_NONE; pred <= LZ_PRED_LORENZO; pred++)
+    for (quant = LZ_QUANT_TRUNCATE; quant <= LZ_QUANT_ROUND; quant++)
+    for (narrow = LZ_NARROW_NEVER; narrow <= LZ_NARROW_FLOAT; narrow++)
+    for (lossy = 0; lossy <= 1; lossy++)
+    for (threads = 1; threads <= NB_THREADS; threads = threads+NB_THREADS-1)
+    {
+        ctx = lzCreateContext();
+        if (ctx == NULL) return report("context", EXIT_FAILURE);
+        lzSelectPredictor(ctx, pred);
+        lzSelectQuantizer(ctx, quant);
+        lzSelectNarrowing(ctx, narrow);
+        absErr = (lossy) ? ABS_ERR : 0;
+        sprintf(name, "double pred %d quant %d narrow %d lossy %d threads %d", pred, quant, narrow, lossy, threads);
+        report(name, tripDoubleCtx(ctx, dBuf, nbEle, absErr, quant, threads));
+        sprintf(name, "narrowed double pred %d quant %d narrow %d lossy %d threads %d", pred, quant, narrow, lossy, threads);
+        report(name, tripDoubleCtx(ctx, nBuf, nbEle, absErr, quant, threads));
+        if (narrow == LZ_NARROW_NEVER)
+        {
+            sprintf(name, "float pred %d quant %d lossy %d threads %d", pred, quant, lossy, threads);
+            report(name, tripFloatCtx(ctx, fBuf, nbEle, absErr, quant, threads));
+        }
+        lzDestroyContext(ctx);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int testShortLorenzo(void)
+{ // Fewer elements than the Lorenzo stencil reaches back, with narrowing asked for
+    double daBuf[7];
+    int i, quant;
+    lzContext *ctx;
+    for (i = 0; i < 7; i++) daBuf[i] = (float)sin(i*0.001)*1000;
+    for (quant = LZ_QUANT_TRUNCATE; quant <= LZ_QUANT_ROUND; quant++)
+    {
+        ctx = lzCreateContext();
+        if (ctx == NULL) return report("context", EXIT_FAILURE);
+        lzSelectPredictor(ctx, LZ_PRED_LORENZO);
+        lzSelectNarrowing(ctx, LZ_NARROW_FLOAT);
+        lzSelectQuantizer(ctx, quant);
+        report("short Lorenzo narrowed lossless", tripDoubleCtx(ctx, daBuf, 7, 0, quant, 1));
+        report("short Lorenzo narrowed lossy", tripDoubleCtx(ctx, daBuf, 7, ABS_ERR, quant, 1));
+        lzDestroyContext(ctx);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int testModes(double *dBuf, float *fBuf, ulong nbEle)
+{ // The adaptive plane coder, alone and under a predictor
+    char name[128];
+    int mode, pred;
+    lzContext *ctx;
+    for (mode = LZ_MODE_DEFLATE; mode <= LZ_MODE_ADAPTIVE; mode++)
+    for (pred = LZ_PRED_NONE; pred <= LZ_PRED_DELTA; pred = pred+LZ_PRED_DELTA)
+    {
+        ctx = lzCreateContext();
+        if (ctx == NULL) return report("context", EXIT_FAILURE);
+        lzSelectMode(ctx, mode);
+        lzSelectPredictor(ctx, pred);
+        sprintf(name, "mode %d pred %d double", mode, pred);
+        report(name, tripDoubleCtx(ctx, dBuf, nbEle, 0, LZ_QUANT_TRUNCATE, 1));
+        sprintf(name, "mode %d pred %d float lossy threads", mode, pred);
+        report(name, tripFloatCtx(ctx, fBuf, nbEle, ABS_ERR, LZ_QUANT_TRUNCATE, NB_THREADS));
+        lzDestroyContext(ctx);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int testDelta(double *dBuf, ulong nbEle)
+{ // The reference is either the previous snapshot or its decoded copy
+    ulong i, outSize, darSize;
+    double *curBuf = malloc(nbEle*sizeof(double)), *refBuf = malloc(nbEle*sizeof(double)), *decBuf = malloc(nbEle*sizeof(double));
+    uchar *dstBuf = malloc(lzCompressDoubleBound(nbEle, 64));
+    short protect = lzErrorProtect((uchar *)dBuf, nbEle, sizeof(double), ABS_ERR, LZ_QUANT_TRUNCATE);
+    int res;
+    if ((curBuf == NULL) || (refBuf == NULL) || (decBuf == NULL) || (dstBuf == NULL)) return report("delta buffers", EXIT_FAILURE);
+    for (i = 0; i < nbEle; i++) curBuf[i] = dBuf[i]+((i%13 == 0) ? 0.25 : 0);
+    outSize = lzCompressDoubleBound(nbEle, 64);
+    darSize = nbEle;
+    res = lzCompressDoubleDelta(dstBuf, &outSize, curBuf, dBuf, nbEle, LEVEL, 64, NB_THREADS);
+    if (res == EXIT_SUCCESS) res = lzUncompressDoubleDelta(decBuf, &darSize, dBuf, dstBuf, outSize, NB_THREADS);
+    if (res == EXIT_SUCCESS) res = sameDoubles(curBuf, decBuf, nbEle, 0);
+    report("delta lossless", res);
+    outSize = lzCompressDoubleBound(nbEle, protect);
+    darSize = nbEle;
+    res = lzCompressDouble(dstBuf, &outSize, dBuf, nbEle, LEVEL, protect);
+    if (res == EXIT_SUCCESS) res = lzUncompressDouble(refBuf, &darSize, dstBuf, outSize);
+    report("delta lossy reference", res);
+    outSize = lzCompressDoubleBound(nbEle, protect);
+    darSize = nbEle;
+    res = lzCompressDoubleDelta(dstBuf, &outSize, curBuf, dBuf, nbEle, LEVEL, protect, 1);
+    if (res == EXIT_SUCCESS) res = lzUncompressDoubleDelta(decBuf, &darSize, refBuf, dstBuf, outSize, 1);
+    if (res == EXIT_SUCCESS) res = sameDoubles(curBuf, decBuf, nbEle, ABS_ERR);
+    report("delta lossy against the decoded reference", res);
+    free(curBuf);
+    free(refBuf);
+    free(decBuf);
+    free(dstBuf);
+    return EXIT_SUCCESS;
+}
+
+
+int testDictionary(double *dBuf, ulong nbEle)
+{ // The first elements are the sample, the rest is compressed with it under each quantizer, threads must not change the bytes
+    char name[128];
+    ulong sample = nbEle/10, outSize, mtSize, darSize;
+    double *decBuf = malloc(nbEle*sizeof(double));
+    uchar *dstBuf = malloc(lzCompressDoubleBound(nbEle, 64)), *mtBuf = malloc(lzCompressDoubleBound(nbEle, 64));
+    short protect;
+    int quant, res;
+    lzContext *ctx;
+    lzDContext *dctx;
+    if ((decBuf == NULL) || (dstBuf == NULL) || (mtBuf == NULL)) return report("dictionary buffers", EXIT_FAILURE);
+    for (quant = LZ_QUANT_TRUNCATE; quant <= LZ_QUANT_ROUND; quant++)
+    {
+        ctx = lzCreateContext();
+        dctx = lzCreateDContext();
+        if ((ctx == NULL) || (dctx == NULL)) return report("dictionary contexts", EXIT_FAILURE);
+        lzSelectQuantizer(ctx, quant);
+        protect = lzErrorProtect((uchar *)dBuf, nbEle, sizeof(double), ABS_ERR, quant);
+        res = lzSetDictionary(ctx, (uchar *)dBuf, sample, sizeof(double), protect);
+        if (res == EXIT_SUCCESS) res = lzSetDDictionary(dctx, (uchar *)dBuf, sample, sizeof(double), protect);
+        outSize = lzCompressDoubleBound(nbEle, protect);
+        darSize = nbEle;
+        if (res == EXIT_SUCCESS) res = lzCompressDoubleCtx(ctx, dstBuf, &outSize, dBuf+sample, nbEle-sample, LEVEL, protect);
+        if (res == EXIT_SUCCESS) res = lzUncompressDoubleCtx(dctx, decBuf, &darSize, dstBuf, outSize);
+        if ((res == EXIT_SUCCESS) && (darSize != nbEle-sample)) res = EXIT_FAILURE;
+        if (res == EXIT_SUCCESS) res = sameDoubles(dBuf+sample, decBuf, nbEle-sample, ABS_ERR);
+        sprintf(name, "dictionary quant %d", quant);
+        report(name, res);
+        mtSize = lzCompressDoubleBound(nbEle, protect);
+        if (res == EXIT_SUCCESS) res = lzCompressDoubleCtxMT(ctx, mtBuf, &mtSize, dBuf+sample, nbEle-sample, LEVEL, protect, NB_THREADS);
+        if ((res == EXIT_SUCCESS) && ((mtSize != outSize) || (memcmp(mtBuf, dstBuf, outSize) != 0))) res = EXIT_FAILURE;
+        sprintf(name, "dictionary quant %d threads", quant);
+        report(name, res);
+        lzDestroyContext(ctx);
+        lzDestroyDContext(dctx);
+    }
+    free(decBuf);
+    free(dstBuf);
+    free(mtBuf);
+    return EXIT_SUCCESS;
+}
+
+
+int testIntegers(ulong nbEle)
+{ // Signed 32-bit and unsigned 16-bit arrays under every transform
+    char name[128];
+    ulong i, outSize, darSize;
+    int *iBuf = malloc(nbEle*sizeof(int)), *iDec = malloc(nbEle*sizeof(int));
+    ushort *uBuf = malloc(nbEle*sizeof(ushort)), *uDec = malloc(nbEle*sizeof(ushort));
+    uchar *dstBuf = malloc(lzCompressIntBound(nbEle, sizeof(int)));
+    int transform, res;
+    if ((iBuf == NULL) || (iDec == NULL) || (uBuf == NULL) || (uDec == NULL) || (dstBuf == NULL)) return report("integer buffers", EXIT_FAILURE);
+    for (i = 0; i < nbEle; i++)
+    {
+        iBuf[i] = (int)(1000*sin(i*0.001))-(int)(i%7);
+        uBuf[i] = (ushort)(i/3+(i%5));
+    }
+    for (transform = 0; transform <= (LZ_INT_DELTA | LZ_INT_ZIGZAG); transform++)
+    {
+        outSize = lzCompressIntBound(nbEle, sizeof(int));
+        darSize = nbEle;
+        res = lzCompressInt(dstBuf, &outSize, iBuf, nbEle, sizeof(int), LEVEL, transform, NB_THREADS);
+        if (res == EXIT_SUCCESS) res = lzUncompressInt(iDec, &darSize, dstBuf, outSize, sizeof(int), NB_THREADS);
+        if ((res == EXIT_SUCCESS) && ((darSize != nbEle) || (memcmp(iBuf, iDec, nbEle*sizeof(int)) != 0))) res = EXIT_FAILURE;
+        sprintf(name, "int transform %d", transform);
+        report(name, res);
+        outSize = lzCompressIntBound(nbEle, sizeof(ushort));
+        darSize = nbEle;
+        res = lzCompressUInt(dstBuf, &outSize, uBuf, nbEle, sizeof(ushort), LEVEL, transform, 1);
+        if (res == EXIT_SUCCESS) res = lzUncompressUInt(uDec, &darSize, dstBuf, outSize, sizeof(ushort), 1);
+        if ((res == EXIT_SUCCESS) && ((darSize != nbEle) || (memcmp(uBuf, uDec, nbEle*sizeof(ushort)) != 0))) res = EXIT_FAILURE;
+        sprintf(name, "uint transform %d", transform);
+        report(name, res);
+    }
+    free(iBuf);
+    free(iDec);
+    free(uBuf);
+    free(uDec);
+    free(dstBuf);
+    return EXIT_SUCCESS;
+}
+
+
+int testHalves(float *fBuf, ulong nbEle)
+{ // The floats come back as the conversion kernels round them, the 16-bit arrays bit for bit
+    ulong outSize, darSize;
+    ushort *hBuf = malloc(nbEle*sizeof(ushort)), *hDec = malloc(nbEle*sizeof(ushort));
+    float *refBuf = malloc(nbEle*sizeof(float)), *decBuf = malloc(nbEle*sizeof(float));
+    uchar *dstBuf = malloc(lzCompressHalfBound(nbEle, 16));
+    int res;
+    if ((hBuf == NULL) || (hDec == NULL) || (refBuf == NULL) || (decBuf == NULL) || (dstBuf == NULL)) return report("half buffers", EXIT_FAILURE);
+    lzFloatToHalf(hBuf, fBuf, nbEle);
+    lzHalfToFloat(refBuf, hBuf, nbEle);
+    outSize = lzCompressHalfBound(nbEle, 16);
+    darSize = nbEle;
+    res = lzCompressHalf(dstBuf, &outSize, hBuf, nbEle, LEVEL, 16);
+    if (res == EXIT_SUCCESS) res = lzUncompressHalf(hDec, &darSize, dstBuf, outSize);
+    if ((res == EXIT_SUCCESS) && ((darSize != nbEle) || (memcmp(hBuf, hDec, nbEle*sizeof(ushort)) != 0))) res = EXIT_FAILURE;
+    report("half", res);
+    outSize = lzCompressHalfBound(nbEle, 16);
+    darSize = nbEle;
+    res = lzCompressFloatAsHalf(dstBuf, &outSize, fBuf, nbEle, LEVEL, 16);
+    if (res == EXIT_SUCCESS) res = lzUncompressHalfToFloat(decBuf, &darSize, dstBuf, outSize);
+    if ((res == EXIT_SUCCESS) && ((darSize != nbEle) || (sameFloats(refBuf, decBuf, nbEle, 0) != EXIT_SUCCESS))) res = EXIT_FAILURE;
+    report("float as half", res);
+    lzFloatToBFloat(hBuf, fBuf, nbEle);
+    lzBFloatToFloat(refBuf, hBuf, nbEle);
+    outSize = lzCompressHalfBound(nbEle, 16);
+    darSize = nbEle;
+    res = lzCompressBFloat(dstBuf, &outSize, hBuf, nbEle, LEVEL, 16);
+    if (res == EXIT_SUCCESS) res = lzUncompressBFloat(hDec, &darSize, dstBuf, outSize);
+    if ((res == EXIT_SUCCESS) && ((darSize != nbEle) || (memcmp(hBuf, hDec, nbEle*sizeof(ushort)) != 0))) res = EXIT_FAILURE;
+    report("bfloat", res);
+    outSize = lzCompressHalfBound(nbEle, 16);
+    darSize = nbEle;
+    res = lzCompressFloatAsBFloat(dstBuf, &outSize, fBuf, nbEle, LEVEL, 16);
+    if (res == EXIT_SUCCESS) res = lzUncompressBFloatToFloat(decBuf, &darSize, dstBuf, outSize);
+    if ((res == EXIT_SUCCESS) && ((darSize != nbEle) || (sameFloats(refBuf, decBuf, nbEle, 0) != EXIT_SUCCESS))) res = EXIT_FAILURE;
+    report("float as bfloat", res);
+    free(hBuf);
+    free(hDec);
+    free(refBuf);
+    free(decBuf);
+    free(dstBuf);
+    return EXIT_SUCCESS;
+}
+
+
+int testStream(double *dBuf, ulong nbEle)
+{ // Fed in uneven pieces with a flush in the middle, lossless then lossy
+    ulong i, piece, darSize;
+    double *decBuf = malloc(nbEle*sizeof(double));
+    short protect;
+    int lossy, res;
+    outStream out;
+    lzStream *strm;
+    if (decBuf == NULL) return report("stream buffer", EXIT_FAILURE);
+    for (lossy = 0; lossy <= 1; lossy++)
+    {
+        memset(&out, 0, sizeof(outStream));
+        protect = (lossy) ? lzErrorProtect((uchar *)dBuf, nbEle, sizeof(double), ABS_ERR, LZ_QUANT_TRUNCATE) : 64;
+        strm = lzStreamInit(sizeof(double), LEVEL, protect, writeStream, &out);
+        res = (strm == NULL) ? EXIT_FAILURE : EXIT_SUCCESS;
+        for (i = 0; (i < nbEle) && (res == EXIT_SUCCESS); i = i+piece)
+        {
+            piece = (nbEle-i < 12345) ? nbEle-i : 12345;
+            res = lzStreamFeed(strm, dBuf+i, piece);
+            if ((res == EXIT_SUCCESS) && (i < nbEle/2) && (i+piece >= nbEle/2)) res = lzStreamFlush(strm);
+        }
+        if ((lzStreamEnd(strm) != EXIT_SUCCESS) || (lzStreamLength(out.buf, out.size) != nbEle)) res = EXIT_FAILURE;
+        darSize = nbEle;
+        if (res == EXIT_SUCCESS) res = lzUncompressDoubleStream(decBuf, &darSize, out.buf, out.size);
+        if ((res == EXIT_SUCCESS) && (darSize != nbEle)) res = EXIT_FAILURE;
+        if (res == EXIT_SUCCESS) res = sameDoubles(dBuf, decBuf, nbEle, (lossy) ? ABS_ERR : 0);
+        report((lossy) ? "stream lossy" : "stream lossless", res);
+        free(out.buf);
+    }
+    free(decBuf);
+    return EXIT_SUCCESS;
+}
+
+
+int testRange(double *dBuf, ulong nbEle)
+{ // A slice across a chunk boundary, from a container with and without a predictor
+    char name[128];
+    ulong first = (CHUNK_SIZE/sizeof(double))-1000, count = 5000, outSize;
+    double *decBuf = malloc(count*sizeof(double));
+    uchar *dstBuf = malloc(lzCompressDoubleBound(nbEle, 64));
+    int pred, res;
+    lzContext *ctx;
+    if ((decBuf == NULL) || (dstBuf == NULL) || (first+count > nbEle)) return report("range buffers", EXIT_FAILURE);
+    for (pred = LZ_PRED_NONE; pred <= LZ_PRED_DFCM; pred++)
+    {
+        ctx = lzCreateContext();
+        if (ctx == NULL) return report("context", EXIT_FAILURE);
+        lzSelectPredictor(ctx, pred);
+        outSize = lzCompressDoubleBound(nbEle, 64);
+        res = lzCompressDoubleCtxMT(ctx, dstBuf, &outSize, dBuf, nbEle, LEVEL, 64, NB_THREADS);
+        if (res == EXIT_SUCCESS) res = lzUncompressDoubleRange(decBuf, dstBuf, outSize, first, count);
+        if (res == EXIT_SUCCESS) res = sameDoubles(dBuf+first, decBuf, count, 0);
+        sprintf(name, "range pred %d", pred);
+        report(name, res);
+        lzDestroyContext(ctx);
+    }
+    free(decBuf);
+    free(dstBuf);
+    return EXIT_SUCCESS;
+}
+
+
+int testPlanes(float *fBuf, ulong nbEle)
+{ // A single chunk has its planes threaded, the bytes must be those of one thread, also when noise leaves the last plane short of room
+    char name[128];
+    ulong i, count = CHUNK_SIZE/sizeof(double), bound = lzCompressDoubleBound(count, 64), trim, outSize, mtSize;
+    double *noise = malloc(count*sizeof(double));
+    uchar *dstBuf = malloc(bound), *mtBuf = malloc(bound);
+    short protect = lzErrorProtect((uchar *)fBuf, count, sizeof(float), ABS_ERR, LZ_QUANT_TRUNCATE);
+    int mode, res, mtRes;
+    lzContext *ctx;
+    if ((noise == NULL) || (dstBuf == NULL) || (mtBuf == NULL) || (count > nbEle)) return report("plane buffers", EXIT_FAILURE);
+    for (i = 0; i < count*sizeof(double); i++) ((uchar *)noise)[i] = rand()%256;
+    for (mode = LZ_MODE_DEFLATE; mode <= LZ_MODE_ADAPTIVE; mode++)
+    {
+        ctx = lzCreateContext();
+        if (ctx == NULL) return report("context", EXIT_FAILURE);
+        lzSelectMode(ctx, mode);
+        for (trim = 0; trim <= 1; trim++)
+        { // Deflate makes noise larger, one byte short of that the last plane goes plain
+            outSize = bound;
+            res = lzCompressDoubleCtx(ctx, dstBuf, &outSize, noise, count, LEVEL, 64);
+            if ((res == EXIT_SUCCESS) && (trim) && (mode == LZ_MODE_DEFLATE))
+            {
+                outSize = outSize-1;
+                res = lzCompressDoubleCtx(ctx, dstBuf, &outSize, noise, count, LEVEL, 64);
+            }
+            mtSize = (trim) ? outSize : bound;
+            mtRes = lzCompressDoubleCtxMT(ctx, mtBuf, &mtSize, noise, count, LEVEL, 64, NB_THREADS);
+            if ((mtRes != res) || ((res == EXIT_SUCCESS) && ((mtSize != outSize) || (memcmp(mtBuf, dstBuf, outSize) != 0)))) res = EXIT_FAILURE;
+            sprintf(name, "planes mode %d trim %lu", mode, trim);
+            report(name, res);
+        }
+        outSize = lzCompressFloatBound(count, protect);
+        mtSize = outSize;
+        res = lzCompressFloatCtx(ctx, dstBuf, &outSize, fBuf, count, LEVEL, protect);
+        mtRes = lzCompressFloatCtxMT(ctx, mtBuf, &mtSize, fBuf, count, LEVEL, protect, NB_THREADS);
+        if ((mtRes != res) || ((res == EXIT_SUCCESS) && ((mtSize != outSize) || (memcmp(mtBuf, dstBuf, outSize) != 0)))) res = EXIT_FAILURE;
+        sprintf(name, "planes mode %d float lossy", mode);
+        report(name, res);
+        lzDestroyContext(ctx);
+    }
+    free(noise);
+    free(dstBuf);
+    free(mtBuf);
+    return EXIT_SUCCESS;
+}
+
+
+int testThreads(double *dBuf, float *fBuf, ulong nbEle)
+{ // The context-free multithreaded, chunked and 3D entry points
+    ulong nx = 100, ny = 50, nz = nbEle/5000, ox, oy, oz, outSize, darSize;
+    double *decBuf = malloc(nbEle*sizeof(double));
+    float *fDec = malloc(nbEle*sizeof(float));
+    uchar *dstBuf = malloc(lzCompressDoubleBound(nbEle, 64));
+    short protect = lzErrorProtect((uchar *)fBuf, nbEle, sizeof(float), ABS_ERR, LZ_QUANT_TRUNCATE);
+    int res;
+    if ((decBuf == NULL) || (fDec == NULL) || (dstBuf == NULL)) return report("thread buffers", EXIT_FAILURE);
+    outSize = lzCompressDoubleBound(nbEle, 64);
+    darSize = nbEle;
+    res = lzCompressDoubleMT(dstBuf, &outSize, dBuf, nbEle, LEVEL, 64, NB_THREADS);
+    if (res == EXIT_SUCCESS) res = lzUncompressDoubleMT(decBuf, &darSize, dstBuf, outSize, NB_THREADS);
+    if ((res == EXIT_SUCCESS) && ((darSize != nbEle) || (sameDoubles(dBuf, decBuf, nbEle, 0) != EXIT_SUCCESS))) res = EXIT_FAILURE;
+    report("double MT", res);
+    outSize = lzCompressFloatChunkedBound(nbEle, protect);
+    darSize = nbEle;
+    res = lzCompressFloatChunked(dstBuf, &outSize, fBuf, nbEle, LEVEL, protect, NB_THREADS);
+    if (res == EXIT_SUCCESS) res = lzUncompressFloatChunked(fDec, &darSize, dstBuf, outSize, NB_THREADS);
+    if ((res == EXIT_SUCCESS) && ((darSize != nbEle) || (sameFloats(fBuf, fDec, nbEle, ABS_ERR) != EXIT_SUCCESS))) res = EXIT_FAILURE;
+    report("float chunked lossy", res);
+    outSize = lzCompressFloat3DBound(nx, ny, nz, 32);
+    res = lzCompressFloat3D(dstBuf, &outSize, fBuf, nx, ny, nz, LEVEL, 32);
+    if (res == EXIT_SUCCESS) res = lzUncompressFloat3D(fDec, &ox, &oy, &oz, dstBuf, outSize);
+    if ((res == EXIT_SUCCESS) && ((ox != nx) || (oy != ny) || (oz != nz) || (sameFloats(fBuf, fDec, nx*ny*nz, 0) != EXIT_SUCCESS))) res = EXIT_FAILURE;
+    report("float 3D", res);
+    free(decBuf);
+    free(fDec);
+    free(dstBuf);
+    return EXIT_SUCCESS;
+}
+
+
+int main(void)
+{
+    ulong nbEle = NB_ELE;
+    double *dBuf = malloc(nbEle*sizeof(double)), *nBuf = malloc(nbEle*sizeof(double));
+    float *fBuf = malloc(nbEle*sizeof(float));
+
+    if ((dBuf == NULL) || (nBuf == NULL) || (fBuf == NULL)) return EXIT_FAILURE;
+    fillArrays(dBuf, fBuf, nBuf, nbEle);
+    testIsa(dBuf, fBuf, nbEle);
+    testSelectors(dBuf, fBuf, nBuf, nbEle);
+    testShortLorenzo();
+    testModes(dBuf, fBuf, nbEle);
+    testDelta(dBuf, nbEle);
+    testDictionary(dBuf, nbEle);
+    testIntegers(nbEle);
+    testHalves(fBuf, nbEle);
+    testStream(dBuf, nbEle);
+    testRange(dBuf, nbEle);
+    testPlanes(fBuf, nbEle);
+    testThreads(dBuf, fBuf, nbEle);
+    printf("%d round trips, %d failed\n", nbTrips, nbFails);
+    free(dBuf);
+    free(nBuf);
+    free(fBuf);
+    lzPoolShutdown();
+    return (nbFails == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}